@@ -1,32 +1,57 @@
 #include "aht.h"
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
 #include "freertos/task.h"
 #include "esp_mac.h"
 
 #define AHT10_ADDRESS 0x38
-static i2c_port_t aht_port;
+#define AHT10_FREQ_HZ 400000
+#define AHT10_TIMEOUT_MS 100
+static i2c_master_dev_handle_t aht_dev;
+
+// The sensor shares the bus created by the display driver
+esp_err_t aht_init(i2c_master_bus_handle_t bus) {
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = AHT10_ADDRESS,
+        .scl_speed_hz = AHT10_FREQ_HZ,
+    };
+    esp_err_t err = i2c_master_bus_add_device(bus, &dev_cfg, &aht_dev);
+    if (err != ESP_OK) return err;
 
-esp_err_t aht_init(i2c_port_t port) {
-    aht_port = port;
     uint8_t cmd[] = {0xBE, 0x08, 0x00};
-    return i2c_master_write_to_device(port, AHT10_ADDRESS, cmd, sizeof(cmd), pdMS_TO_TICKS(100));
+    return i2c_master_transmit(aht_dev, cmd, sizeof(cmd), AHT10_TIMEOUT_MS);
 }
 
-esp_err_t aht_read(float *temperature, float *humidity) {
-    uint8_t data[6];
-    
-    uint8_t trigger_cmd[] = {0xAC, 0x33, 0x00};
-    i2c_master_write_to_device(aht_port, 0x38, trigger_cmd, sizeof(trigger_cmd), pdMS_TO_TICKS(100));
-
-    vTaskDelay(pdMS_TO_TICKS(80));
-
-    esp_err_t err = i2c_master_read_from_device(aht_port, AHT10_ADDRESS, data, 6, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) return err;
-
+// Status byte, 20 bits of humidity, 20 bits of temperature
+void aht_convert(const uint8_t data[6], float *temperature, float *humidity) {
     uint32_t raw_hum = ((uint32_t)data[1] << 12) | ((uint32_t)data[2] << 4) | (data[3] >> 4);
     uint32_t raw_temp = (((uint32_t)data[3] & 0x0F) << 16) | ((uint32_t)data[4] << 8) | data[5];
 
     *humidity = ((float)raw_hum) * 100 / 1048576;
     *temperature = ((float)raw_temp) * 200 / 1048576 - 50;
+}
+
+// Start a measurement, the result is ready AHT_MEASURE_MS later
+esp_err_t aht_trigger(void) {
+    uint8_t trigger_cmd[] = {0xAC, 0x33, 0x00};
+    return i2c_master_transmit(aht_dev, trigger_cmd, sizeof(trigger_cmd), AHT10_TIMEOUT_MS);
+}
+
+esp_err_t aht_fetch(float *temperature, float *humidity) {
+    uint8_t data[6];
+
+    esp_err_t err = i2c_master_receive(aht_dev, data, 6, AHT10_TIMEOUT_MS);
+    if (err != ESP_OK) return err;
+
+    aht_convert(data, temperature, humidity);
     return ESP_OK;
 }
+
+esp_err_t aht_read(float *temperature, float *humidity) {
+    esp_err_t err = aht_trigger();
+    if (err != ESP_OK) return err;
+
+    vTaskDelay(pdMS_TO_TICKS(AHT_MEASURE_MS));
+
+    return aht_fetch(temperature, humidity);
+}
@@ -1,7 +1,16 @@
 #pragma once
 
 #include "esp_err.h"
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
 
-esp_err_t aht_init(i2c_port_t port);
-esp_err_t aht_read(float *temperature, float *humidity);
\ No newline at end of file
+#define AHT_MEASURE_MS 80
+
+esp_err_t aht_init(i2c_master_bus_handle_t bus);
+esp_err_t aht_read(float *temperature, float *humidity); // trigger, wait, fetch
+
+// The same in two steps, for callers that do something else meanwhile
+esp_err_t aht_trigger(void);
+esp_err_t aht_fetch(float *temperature, float *humidity);
+
+// Raw measurement frame as read by aht_fetch to physical units
+void aht_convert(const uint8_t data[6], float *temperature, float *humidity);
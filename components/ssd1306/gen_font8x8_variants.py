@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Generate the inverted, flipped and rotated variants of font8x8_basic_tr.
+
+The variants are what ssd1306_invert(), ssd1306_flip() and
+ssd1306_rotate_image() would produce at runtime, laid out as
+font8x8_variants[flags][code][8] with flags a combination of
+SSD1306_GLYPH_INVERT (1), SSD1306_GLYPH_FLIP (2) and SSD1306_GLYPH_ROTATE (4).
+
+usage: gen_font8x8_variants.py font8x8_basic.h font8x8_variants.h
+"""
+
+import re
+import sys
+
+GLYPH_INVERT = 0x01
+GLYPH_FLIP = 0x02
+GLYPH_ROTATE = 0x04
+
+
+def read_font(path):
+    with open(path) as f:
+        text = f.read()
+    table = text[text.index('font8x8_basic_tr[128][8]'):]
+    glyphs = []
+    for row in re.finditer(r'\{([^{}]*)\}', table):
+        values = [int(v, 16) for v in re.findall(r'0x[0-9A-Fa-f]{2}', row.group(1))]
+        if len(values) == 8:
+            glyphs.append(values)
+    if len(glyphs) != 128:
+        sys.exit('%s: expected 128 glyphs, found %d' % (path, len(glyphs)))
+    return glyphs
+
+
+def rotate_byte(b):
+    return int('{:08b}'.format(b)[::-1], 2)
+
+
+def rotate_image(image):
+    # Same as ssd1306_rotate_image() without the flip
+    out = []
+    for i in range(8):
+        wk = 0
+        for j in range(8):
+            if image[j] & (1 << i):
+                wk |= 0x80 >> j
+        out.append(wk)
+    return out
+
+
+def variant(image, flags):
+    if flags & GLYPH_ROTATE:
+        image = rotate_image(image)
+    if flags & GLYPH_INVERT:
+        image = [~b & 0xFF for b in image]
+    if flags & GLYPH_FLIP:
+        image = [rotate_byte(b) for b in image]
+    return image
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    glyphs = read_font(sys.argv[1])
+
+    lines = [
+        '/* Generated by gen_font8x8_variants.py from font8x8_basic.h, do not edit. */',
+        '',
+        '#ifndef MAIN_FONT8X8_VARIANTS_H_',
+        '#define MAIN_FONT8X8_VARIANTS_H_',
+        '',
+        'static const uint8_t font8x8_variants[8][128][8] = {',
+    ]
+    for flags in range(8):
+        names = [name for bit, name in ((GLYPH_INVERT, 'INVERT'), (GLYPH_FLIP, 'FLIP'), (GLYPH_ROTATE, 'ROTATE')) if flags & bit]
+        lines.append('    {   // %s' % ('|'.join(names) or 'plain'))
+        for code, image in enumerate(glyphs):
+            values = ', '.join('0x%02X' % b for b in variant(image, flags))
+            lines.append('        { %s },   // U+%04X' % (values, code))
+        lines.append('    },')
+    lines += [
+        '};',
+        '',
+        '#endif /* MAIN_FONT8X8_VARIANTS_H_ */',
+        '',
+    ]
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()
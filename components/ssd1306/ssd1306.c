@@ -1,12 +1,14 @@
 #include <string.h>
+#include <stdlib.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 
 #include "ssd1306.h"
-#include "font8x8_basic.h"
+#include "font8x8_variants.h"
 
 #define PACK8 __attribute__((aligned( __alignof__( uint8_t ) ), packed ))
 
@@ -15,17 +17,69 @@ typedef union out_column_t {
 	uint8_t  u8[4];
 } PACK8 out_column_t;
 
+// Unchanged bytes between two changed runs are resent rather than starting a
+// new write when the gap is shorter than the addressing overhead of a write.
+#define SSD1306_SPAN_MERGE_GAP 6
+
+// True when the caller must not touch the bus: a flush task owns it
+static bool ssd1306_flush_owned(SSD1306_t * dev)
+{
+	return dev->_flushTask != NULL && xTaskGetCurrentTaskHandle() != dev->_flushTask;
+}
+
+// Send to the panel and remember what it holds now. Once a flush task owns
+// the bus the images go to the internal buffer and the frame is handed over,
+// so writes stay in order with ssd1306_show_buffer and the shadow keeps
+// matching the panel.
+static void ssd1306_write_panel(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width)
+{
+	if (ssd1306_flush_owned(dev)) {
+		if (page < 0 || page >= dev->_pages || seg < 0 || seg >= dev->_width) return;
+		if (seg + width > dev->_width) width = dev->_width - seg;
+		if (images != &dev->_page[page]._segs[seg]) memmove(&dev->_page[page]._segs[seg], images, width);
+		ssd1306_mark_dirty(dev, page, seg, width);
+		ssd1306_flush_dirty(dev);
+		return;
+	}
+	if (dev->_address == SPI_ADDRESS) {
+		spi_display_image(dev, page, seg, images, width);
+	} else {
+		i2c_display_image(dev, page, seg, images, width);
+	}
+	if (page >= dev->_pages || seg >= dev->_width) return;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	memcpy(&dev->_shadow[page * dev->_width + seg], images, width);
+}
+
+// Set up the panel and allocate the internal buffer and its shadow for
+// exactly width x height pixels
 void ssd1306_init(SSD1306_t * dev, int width, int height)
 {
+	if (width > SSD1306_MAX_WIDTH || height > SSD1306_MAX_PAGES * 8) {
+		ESP_LOGE(__FUNCTION__, "panel %dx%d is too large", width, height);
+		return;
+	}
 	if (dev->_address == SPI_ADDRESS) {
 		spi_init(dev, width, height);
 	} else {
 		i2c_init(dev, width, height);
 	}
 	// Initialize internal buffer
+	int size = dev->_pages * dev->_width;
+	dev->_frame = calloc(2, size);
+	if (dev->_frame == NULL) {
+		ESP_LOGE(__FUNCTION__, "calloc fail");
+		return;
+	}
+	dev->_shadow = dev->_frame + size;
 	for (int i=0;i<dev->_pages;i++) {
-		memset(dev->_page[i]._segs, 0, 128);
+		dev->_page[i]._segs = &dev->_frame[i * dev->_width];
 	}
+	// Panel RAM content is unknown until the first full frame
+	dev->_shadowValid = false;
+	dev->_burst = false;
+	dev->_flushTask = NULL;
+	ssd1306_clear_dirty(dev);
 }
 
 int ssd1306_get_width(SSD1306_t * dev)
@@ -43,25 +97,279 @@ int ssd1306_get_pages(SSD1306_t * dev)
 	return dev->_pages;
 }
 
-void ssd1306_show_buffer(SSD1306_t * dev)
+// Find the next run of changed bytes in a page from *seg on, short unchanged
+// gaps are merged into the run
+static bool ssd1306_next_run(SSD1306_t * dev, const PAGE_t * frame, int page, int * seg, int * start, int * end)
+{
+	const uint8_t *segs = frame[page]._segs;
+	uint8_t *shadow = &dev->_shadow[page * dev->_width];
+	int _seg = *seg;
+	while (_seg < dev->_width && segs[_seg] == shadow[_seg]) _seg++;
+	if (_seg == dev->_width) {
+		*seg = _seg;
+		return false;
+	}
+
+	*start = _seg;
+	*end = _seg;
+	for (_seg++; _seg < dev->_width; _seg++) {
+		if (segs[_seg] != shadow[_seg]) {
+			*end = _seg;
+		} else if (_seg - *end > SSD1306_SPAN_MERGE_GAP) {
+			break;
+		}
+	}
+	*seg = _seg;
+	return true;
+}
+
+// Send a rectangle of frame in one transaction
+static void ssd1306_send_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width)
 {
 	if (dev->_address == SPI_ADDRESS) {
+		spi_display_rect(dev, frame, page, seg, pages, width);
+	} else {
+		i2c_display_rect(dev, frame, page, seg, pages, width);
+	}
+	if (page < 0 || seg < 0) return;
+	if (page + pages > dev->_pages) pages = dev->_pages - page;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (pages <= 0 || width <= 0) return;
+	for (int _page=page; _page<page+pages; _page++) {
+		memcpy(&dev->_shadow[_page * dev->_width + seg], &frame[_page]._segs[seg], width);
+	}
+}
+
+// Send only the column runs of frame that differ from what the panel holds.
+// In burst mode the bounding rectangle of all changes goes in one
+// transaction instead, when that is not more bytes on the bus.
+static void ssd1306_send_frame(SSD1306_t * dev, const PAGE_t * frame)
+{
+	if (dev->_shadowValid == false) {
+		if (dev->_burst) {
+			ssd1306_send_rect(dev, frame, 0, 0, dev->_pages, dev->_width);
+		} else {
+			for (int page=0; page<dev->_pages;page++) {
+				ssd1306_write_panel(dev, page, 0, frame[page]._segs, dev->_width);
+			}
+		}
+		dev->_shadowValid = true;
+		return;
+	}
+
+	int seg, start, end;
+	if (dev->_burst) {
+		int runs = 0;
+		int run_bytes = 0;
+		int top = -1, bottom = -1, left = dev->_width, right = -1;
 		for (int page=0; page<dev->_pages;page++) {
-			spi_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
+			seg = 0;
+			while (ssd1306_next_run(dev, frame, page, &seg, &start, &end)) {
+				runs++;
+				run_bytes = run_bytes + end - start + 1;
+				if (top < 0) top = page;
+				bottom = page;
+				if (start < left) left = start;
+				if (end > right) right = end;
+			}
+		}
+		if (runs == 0) return;
+
+		int rect_bytes = (bottom - top + 1) * (right - left + 1);
+		ESP_LOGD(__FUNCTION__, "runs=%d run_bytes=%d rect_bytes=%d", runs, run_bytes, rect_bytes);
+		if (rect_bytes <= run_bytes + (runs - 1) * SSD1306_SPAN_MERGE_GAP) {
+			ssd1306_send_rect(dev, frame, top, left, bottom - top + 1, right - left + 1);
+			return;
+		}
+	}
+
+	for (int page=0; page<dev->_pages;page++) {
+		seg = 0;
+		while (ssd1306_next_run(dev, frame, page, &seg, &start, &end)) {
+			ESP_LOGD(__FUNCTION__, "page=%d start=%d end=%d", page, start, end);
+			ssd1306_write_panel(dev, page, start, &frame[page]._segs[start], end - start + 1);
+		}
+	}
+}
+
+// Streams the latest swapped frame. A frame swapped in while the previous
+// one is still on the wire replaces any frame that was waiting.
+static void ssd1306_flush_task(void * arg)
+{
+	SSD1306_t * dev = (SSD1306_t *)arg;
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		xSemaphoreTake(dev->_flushMutex, portMAX_DELAY);
+		bool pending = dev->_pendingValid;
+		if (pending) {
+			PAGE_t * wk = dev->_sending;
+			dev->_sending = dev->_pending;
+			dev->_pending = wk;
+			dev->_pendingValid = false;
 		}
+		xSemaphoreGive(dev->_flushMutex);
+		if (pending) {
+			xSemaphoreTake(dev->_busMutex, portMAX_DELAY);
+			ssd1306_send_frame(dev, dev->_sending);
+			xSemaphoreGive(dev->_busMutex);
+		}
+	}
+}
+
+// Hand the panel over to a flush task. From then on ssd1306_show_buffer only
+// copies the internal buffer to the front buffer and returns; draw with the
+// buffer-only functions (_ssd1306_xxx, ssd1306_set_buffer) and leave the
+// transport to the flush task. Functions that write the panel directly
+// (ssd1306_display_image, scrolling) and the text boxes go through the buffer
+// too, and commands (contrast, hardware scroll) wait for the frame on the wire.
+bool ssd1306_start_flush_task(SSD1306_t * dev, UBaseType_t priority)
+{
+	if (dev->_flushTask != NULL) return true;
+	// Two sets of page pointers followed by the two frames they point into
+	int size = dev->_pages * dev->_width;
+	dev->_pending = calloc(1, 2 * dev->_pages * sizeof(PAGE_t) + 2 * size);
+	if (dev->_pending == NULL) {
+		ESP_LOGE(__FUNCTION__, "calloc fail");
+		return false;
+	}
+	dev->_sending = &dev->_pending[dev->_pages];
+	uint8_t *frames = (uint8_t *)&dev->_pending[2 * dev->_pages];
+	for (int page=0; page<dev->_pages; page++) {
+		dev->_pending[page]._segs = &frames[page * dev->_width];
+		dev->_sending[page]._segs = &frames[size + page * dev->_width];
+	}
+	dev->_pendingValid = false;
+	dev->_flushMutex = xSemaphoreCreateMutex();
+	dev->_busMutex = xSemaphoreCreateMutex();
+	if (dev->_flushMutex == NULL || dev->_busMutex == NULL) {
+		ESP_LOGE(__FUNCTION__, "xSemaphoreCreateMutex fail");
+		if (dev->_flushMutex != NULL) vSemaphoreDelete(dev->_flushMutex);
+		if (dev->_busMutex != NULL) vSemaphoreDelete(dev->_busMutex);
+		free(dev->_pending);
+		dev->_pending = NULL;
+		return false;
+	}
+	if (xTaskCreate(ssd1306_flush_task, "ssd1306_flush", 3072, dev, priority, &dev->_flushTask) != pdPASS) {
+		ESP_LOGE(__FUNCTION__, "xTaskCreate fail");
+		vSemaphoreDelete(dev->_flushMutex);
+		vSemaphoreDelete(dev->_busMutex);
+		free(dev->_pending);
+		dev->_pending = NULL;
+		dev->_flushTask = NULL;
+		return false;
+	}
+	return true;
+}
+
+// Publish the internal buffer to the flush task, never waits for the bus
+void ssd1306_swap_buffer(SSD1306_t * dev)
+{
+	xSemaphoreTake(dev->_flushMutex, portMAX_DELAY);
+	for (int page=0; page<dev->_pages;page++) {
+		memcpy(dev->_pending[page]._segs, dev->_page[page]._segs, dev->_width);
+	}
+	dev->_pendingValid = true;
+	xSemaphoreGive(dev->_flushMutex);
+	xTaskNotifyGive(dev->_flushTask);
+}
+
+void ssd1306_show_buffer(SSD1306_t * dev)
+{
+	ssd1306_clear_dirty(dev);
+	if (dev->_flushTask != NULL) {
+		ssd1306_swap_buffer(dev);
+		return;
+	}
+	ssd1306_send_frame(dev, dev->_page);
+}
+
+// Resend the whole frame on the next ssd1306_show_buffer
+void ssd1306_invalidate(SSD1306_t * dev)
+{
+	dev->_shadowValid = false;
+}
+
+// Burst mode: ssd1306_show_buffer streams whole frames and rectangles in
+// Horizontal Addressing Mode instead of page by page
+void ssd1306_set_burst(SSD1306_t * dev, bool enable)
+{
+	dev->_burst = enable;
+}
+
+// Send a rectangle of the internal buffer in one transaction
+void ssd1306_show_rect(SSD1306_t * dev, int page, int seg, int pages, int width)
+{
+	if (ssd1306_flush_owned(dev)) {
+		for (int _page=page; _page<page+pages; _page++) {
+			ssd1306_mark_dirty(dev, _page, seg, width);
+		}
+		ssd1306_flush_dirty(dev);
+		return;
+	}
+	ssd1306_send_rect(dev, dev->_page, page, seg, pages, width);
+}
+
+// Record that columns seg to seg+width-1 of a page changed in the buffer
+void ssd1306_mark_dirty(SSD1306_t * dev, int page, int seg, int width)
+{
+	if (page < 0 || page >= dev->_pages) return;
+	if (seg < 0) {
+		width = width + seg;
+		seg = 0;
+	}
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (width <= 0) return;
+	if (seg < dev->_dirtyStart[page]) dev->_dirtyStart[page] = seg;
+	if (seg + width - 1 > dev->_dirtyEnd[page]) dev->_dirtyEnd[page] = seg + width - 1;
+}
+
+void ssd1306_clear_dirty(SSD1306_t * dev)
+{
+	for (int page=0; page<8; page++) {
+		dev->_dirtyStart[page] = SSD1306_MAX_WIDTH;
+		dev->_dirtyEnd[page] = -1;
+	}
+}
+
+// Send what the buffer-only functions changed since the last flush, one run
+// per page, or one rectangle in burst mode
+void ssd1306_flush_dirty(SSD1306_t * dev)
+{
+	if (dev->_flushTask != NULL || dev->_shadowValid == false) {
+		ssd1306_show_buffer(dev);
+		return;
+	}
+
+	int top = -1, bottom = -1, left = dev->_width, right = -1;
+	for (int page=0; page<dev->_pages; page++) {
+		if (dev->_dirtyStart[page] > dev->_dirtyEnd[page]) continue;
+		if (top < 0) top = page;
+		bottom = page;
+		if (dev->_dirtyStart[page] < left) left = dev->_dirtyStart[page];
+		if (dev->_dirtyEnd[page] > right) right = dev->_dirtyEnd[page];
+	}
+	if (top < 0) return;
+
+	if (dev->_burst && bottom > top) {
+		ssd1306_send_rect(dev, dev->_page, top, left, bottom - top + 1, right - left + 1);
 	} else {
-		for (int page=0; page<dev->_pages;page++) {
-			i2c_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
+		for (int page=top; page<=bottom; page++) {
+			int start = dev->_dirtyStart[page];
+			int end = dev->_dirtyEnd[page];
+			if (start > end) continue;
+			ssd1306_write_panel(dev, page, start, &dev->_page[page]._segs[start], end - start + 1);
 		}
 	}
+	ssd1306_clear_dirty(dev);
 }
 
 void ssd1306_set_buffer(SSD1306_t * dev, const uint8_t * buffer)
 {
 	int index = 0;
 	for (int page=0; page<dev->_pages;page++) {
-		memcpy(&dev->_page[page]._segs, &buffer[index], 128);
-		index = index + 128;
+		memcpy(dev->_page[page]._segs, &buffer[index], dev->_width);
+		ssd1306_mark_dirty(dev, page, 0, dev->_width);
+		index = index + dev->_width;
 	}
 }
 
@@ -69,47 +377,69 @@ void ssd1306_get_buffer(SSD1306_t * dev, uint8_t * buffer)
 {
 	int index = 0;
 	for (int page=0; page<dev->_pages;page++) {
-		memcpy(&buffer[index], &dev->_page[page]._segs, 128);
-		index = index + 128;
+		memcpy(&buffer[index], dev->_page[page]._segs, dev->_width);
+		index = index + dev->_width;
 	}
 }
 
 void ssd1306_set_page(SSD1306_t * dev, int page, const uint8_t * buffer)
 {
-	memcpy(&dev->_page[page]._segs, buffer, 128);
+	memcpy(dev->_page[page]._segs, buffer, dev->_width);
+	ssd1306_mark_dirty(dev, page, 0, dev->_width);
 }
 
 void ssd1306_get_page(SSD1306_t * dev, int page, uint8_t * buffer)
 {
-	memcpy(buffer, &dev->_page[page]._segs, 128);
+	memcpy(buffer, dev->_page[page]._segs, dev->_width);
 }
 
 void ssd1306_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width)
 {
-	if (dev->_address == SPI_ADDRESS) {
-		spi_display_image(dev, page, seg, images, width);
-	} else {
-		i2c_display_image(dev, page, seg, images, width);
-	}
-	// Set to internal buffer
-	memcpy(&dev->_page[page]._segs[seg], images, width);
+	// The frame is exactly _width bytes per page, keep the copy inside it
+	if (page < 0 || page >= dev->_pages || seg < 0 || seg >= dev->_width) return;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	// Set to internal buffer, unless the image is already there, and send
+	// it from there
+	uint8_t *segs = &dev->_page[page]._segs[seg];
+	if (images != segs) memmove(segs, images, width);
+	ssd1306_write_panel(dev, page, seg, segs, width);
 }
 
-void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
+// Glyph of ch as the panel wants it, from the tables generated at build
+// time. flags is a combination of SSD1306_GLYPH_INVERT/FLIP/ROTATE.
+const uint8_t * ssd1306_glyph(uint8_t ch, int flags)
+{
+	return font8x8_variants[flags & 0x07][ch & 0x7F];
+}
+
+// Table flags for the text of a device
+static int ssd1306_text_flags(SSD1306_t * dev, bool invert)
+{
+	int flags = 0;
+	if (invert) flags |= SSD1306_GLYPH_INVERT;
+	if (dev->_flip) flags |= SSD1306_GLYPH_FLIP;
+	return flags;
+}
+
+// Render a line of text into the internal buffer. Not show it.
+void _ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
 {
 	if (page >= dev->_pages) return;
 	int _text_len = text_len;
-	if (_text_len > 16) _text_len = 16;
+	if (_text_len > dev->_width / 8) _text_len = dev->_width / 8;
 
-	int seg = 0;
-	uint8_t image[8];
+	uint8_t *segs = dev->_page[page]._segs;
+	int flags = ssd1306_text_flags(dev, invert);
 	for (int i = 0; i < _text_len; i++) {
-		memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
-		ssd1306_display_image(dev, page, seg, image, 8);
-		seg = seg + 8;
+		memcpy(&segs[i * 8], ssd1306_glyph(text[i], flags), 8);
 	}
+	ssd1306_mark_dirty(dev, page, 0, _text_len * 8);
+}
+
+void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
+{
+	_ssd1306_display_text(dev, page, text, text_len, invert);
+	ssd1306_flush_dirty(dev);
 }
 
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay)
@@ -119,28 +449,27 @@ void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char *
 	if (seg + text_box_pixel > dev->_width) return;
 
 	int _seg = seg;
-	uint8_t image[8];
+	int flags = ssd1306_text_flags(dev, invert);
 	for (int i = 0; i < box_width; i++) {
-		memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
-		ssd1306_display_image(dev, page, _seg, image, 8);
+		const uint8_t *image = ssd1306_glyph(text[i], flags);
+		memcpy(&dev->_page[page]._segs[_seg], image, 8);
 		_seg = _seg + 8;
 	}
+	ssd1306_mark_dirty(dev, page, seg, text_box_pixel);
+	ssd1306_flush_dirty(dev);
 	vTaskDelay(delay);
 
 	// Horizontally scroll inside the box
 	for (int _text=box_width;_text<text_len;_text++) {
-		memcpy(image, font8x8_basic_tr[(uint8_t)text[_text]], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
+		const uint8_t *image = ssd1306_glyph(text[_text], flags);
 		for (int _bit=0;_bit<8;_bit++) {
 			for (int _pixel=0;_pixel<text_box_pixel;_pixel++) {
 				//ESP_LOGI(__FUNCTION__, "_text=%d _bit=%d _pixel=%d", _text, _bit, _pixel);
 				dev->_page[page]._segs[_pixel+seg] = dev->_page[page]._segs[_pixel+seg+1];
 			}
 			dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
-			ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+			ssd1306_mark_dirty(dev, page, seg, text_box_pixel);
+			ssd1306_flush_dirty(dev);
 			vTaskDelay(delay);
 		}
 	}
@@ -153,65 +482,63 @@ void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char *
 	if (seg + text_box_pixel > dev->_width) return;
 
 	int _seg = seg;
-	uint8_t image[8];
+	int flags = ssd1306_text_flags(dev, invert);
 
 	// Fill the text box with blanks
 	for (int i = 0; i < box_width; i++) {
-		//memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
-		memcpy(image, font8x8_basic_tr[0x20], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
-		ssd1306_display_image(dev, page, _seg, image, 8);
+		const uint8_t *image = ssd1306_glyph(0x20, flags);
+		memcpy(&dev->_page[page]._segs[_seg], image, 8);
 		_seg = _seg + 8;
 	}
+	ssd1306_mark_dirty(dev, page, seg, text_box_pixel);
+	ssd1306_flush_dirty(dev);
 	vTaskDelay(delay);
 
 	// Horizontally scroll inside the box
 	for (int _text=0;_text<text_len;_text++) {
-		memcpy(image, font8x8_basic_tr[(uint8_t)text[_text]], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
+		const uint8_t *image = ssd1306_glyph(text[_text], flags);
 		for (int _bit=0;_bit<8;_bit++) {
 			for (int _pixel=0;_pixel<text_box_pixel;_pixel++) {
 				//ESP_LOGI(__FUNCTION__, "_text=%d _bit=%d _pixel=%d", _text, _bit, _pixel);
 				dev->_page[page]._segs[_pixel+seg] = dev->_page[page]._segs[_pixel+seg+1];
 			}
 			dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
-			ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+			ssd1306_mark_dirty(dev, page, seg, text_box_pixel);
+			ssd1306_flush_dirty(dev);
 			vTaskDelay(delay);
 		}
 	}
 
 	// Horizontally scroll inside the box
 	for (int _text=0;_text<box_width;_text++) {
-		memcpy(image, font8x8_basic_tr[0x20], 8);
-		if (invert) ssd1306_invert(image, 8);
-		if (dev->_flip) ssd1306_flip(image, 8);
+		const uint8_t *image = ssd1306_glyph(0x20, flags);
 		for (int _bit=0;_bit<8;_bit++) {
 			for (int _pixel=0;_pixel<text_box_pixel;_pixel++) {
 				//ESP_LOGI(__FUNCTION__, "_text=%d _bit=%d _pixel=%d", _text, _bit, _pixel);
 				dev->_page[page]._segs[_pixel+seg] = dev->_page[page]._segs[_pixel+seg+1];
 			}
 			dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
-			ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+			ssd1306_mark_dirty(dev, page, seg, text_box_pixel);
+			ssd1306_flush_dirty(dev);
 			vTaskDelay(delay);
 		}
 	}
 }
 
 // by Coert Vonk
+// Render 3x high text into the internal buffer. Not show it.
 void 
-ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
+_ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
 {
 	if (page >= dev->_pages) return;
 	int _text_len = text_len;
-	if (_text_len > 5) _text_len = 5;
+	if (_text_len > dev->_width / 24) _text_len = dev->_width / 24;
 
 	int seg = 0;
 
 	for (int nn = 0; nn < _text_len; nn++) {
 
-		uint8_t const * const in_columns = font8x8_basic_tr[(uint8_t)text[nn]];
+		uint8_t const * const in_columns = ssd1306_glyph(text[nn], 0);
 
 		// make the character 3x as high
 		out_column_t out_columns[8];
@@ -242,40 +569,47 @@ ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_l
 			}
 			if (invert) ssd1306_invert(image, 24);
 			if (dev->_flip) ssd1306_flip(image, 24);
-			if (dev->_address == SPI_ADDRESS) {
-				spi_display_image(dev, page+yy, seg, image, 24);
-			} else {
-				i2c_display_image(dev, page+yy, seg, image, 24);
-			}
+			if (page+yy >= dev->_pages) break;
 			memcpy(&dev->_page[page+yy]._segs[seg], image, 24);
+			ssd1306_mark_dirty(dev, page+yy, seg, 24);
 		}
 		seg = seg + 24;
 	}
 }
 
+void ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
+{
+	_ssd1306_display_text_x3(dev, page, text, text_len, invert);
+	ssd1306_flush_dirty(dev);
+}
+
 void ssd1306_clear_screen(SSD1306_t * dev, bool invert)
 {
-	char space[16];
+	char space[SSD1306_MAX_WIDTH / 8];
 	memset(space, 0x00, sizeof(space));
 	for (int page = 0; page < dev->_pages; page++) {
-		ssd1306_display_text(dev, page, space, sizeof(space), invert);
+		_ssd1306_display_text(dev, page, space, dev->_width / 8, invert);
 	}
+	ssd1306_flush_dirty(dev);
 }
 
 void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert)
 {
-	char space[16];
+	char space[SSD1306_MAX_WIDTH / 8];
 	memset(space, 0x00, sizeof(space));
-	ssd1306_display_text(dev, page, space, sizeof(space), invert);
+	ssd1306_display_text(dev, page, space, dev->_width / 8, invert);
 }
 
 void ssd1306_contrast(SSD1306_t * dev, int contrast)
 {
+	bool owned = ssd1306_flush_owned(dev);
+	if (owned) xSemaphoreTake(dev->_busMutex, portMAX_DELAY);
 	if (dev->_address == SPI_ADDRESS) {
 		spi_contrast(dev, contrast);
 	} else {
 		i2c_contrast(dev, contrast);
 	}
+	if (owned) xSemaphoreGive(dev->_busMutex);
 }
 
 void ssd1306_software_scroll(SSD1306_t * dev, int start, int end)
@@ -300,13 +634,6 @@ void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool
 	ESP_LOGD(__FUNCTION__, "dev->_scEnable=%d", dev->_scEnable);
 	if (dev->_scEnable == false) return;
 
-	void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-	if (dev->_address == SPI_ADDRESS) {
-		func = spi_display_image;
-	} else {
-		func = i2c_display_image;
-	}
-
 	int srcIndex = dev->_scEnd - dev->_scDirection;
 	while(1) {
 		int dstIndex = srcIndex + dev->_scDirection;
@@ -314,13 +641,13 @@ void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool
 		for(int seg = 0; seg < dev->_width; seg++) {
 			dev->_page[dstIndex]._segs[seg] = dev->_page[srcIndex]._segs[seg];
 		}
-		(*func)(dev, dstIndex, 0, dev->_page[dstIndex]._segs, sizeof(dev->_page[dstIndex]._segs));
+		ssd1306_write_panel(dev, dstIndex, 0, dev->_page[dstIndex]._segs, dev->_width);
 		if (srcIndex == dev->_scStart) break;
 		srcIndex = srcIndex - dev->_scDirection;
 	}
 	
 	int _text_len = text_len;
-	if (_text_len > 16) _text_len = 16;
+	if (_text_len > dev->_width / 8) _text_len = dev->_width / 8;
 	
 	ssd1306_display_text(dev, srcIndex, text, text_len, invert);
 }
@@ -343,11 +670,70 @@ void ssd1306_scroll_clear(SSD1306_t * dev)
 
 void ssd1306_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
 {
+	bool owned = ssd1306_flush_owned(dev);
+	if (owned) xSemaphoreTake(dev->_busMutex, portMAX_DELAY);
 	if (dev->_address == SPI_ADDRESS) {
 		spi_hardware_scroll(dev, scroll);
 	} else {
 		i2c_hardware_scroll(dev, scroll);
 	}
+	// Scrolling moves the panel RAM content
+	dev->_shadowValid = false;
+	if (owned) xSemaphoreGive(dev->_busMutex);
+}
+
+// Reverse the bit order of every byte of a column, for flipped panels
+static ssd1306_column_t ssd1306_column_flip(ssd1306_column_t column)
+{
+	column = ((column >> 1) & (ssd1306_column_t)0x5555555555555555ULL) | ((column & (ssd1306_column_t)0x5555555555555555ULL) << 1);
+	column = ((column >> 2) & (ssd1306_column_t)0x3333333333333333ULL) | ((column & (ssd1306_column_t)0x3333333333333333ULL) << 2);
+	column = ((column >> 4) & (ssd1306_column_t)0x0F0F0F0F0F0F0F0FULL) | ((column & (ssd1306_column_t)0x0F0F0F0F0F0F0F0FULL) << 4);
+	return column;
+}
+
+// Column-major view of a page-format frame: one word per segment with bit n
+// = pixel row n. stride is the distance in bytes between two pages of frame.
+ssd1306_column_t ssd1306_pack_column(SSD1306_t * dev, const uint8_t * frame, int stride, int seg)
+{
+	ssd1306_column_t column = 0;
+	for (int page=0; page<dev->_pages; page++) {
+		column |= (ssd1306_column_t)frame[page * stride + seg] << (page * 8);
+	}
+	if (dev->_flip) column = ssd1306_column_flip(column);
+	return column;
+}
+
+void ssd1306_unpack_column(SSD1306_t * dev, uint8_t * frame, int stride, int seg, ssd1306_column_t column)
+{
+	if (dev->_flip) column = ssd1306_column_flip(column);
+	for (int page=0; page<dev->_pages; page++) {
+		frame[page * stride + seg] = column >> (page * 8);
+	}
+}
+
+// Rotate the pixel rows of columns start to end by lines, upwards when
+// lines is positive. One shift pair per column instead of carrying bits
+// from page to page.
+void ssd1306_wrap_vertical(SSD1306_t * dev, int start, int end, int lines)
+{
+	int height = dev->_pages * 8;
+	if (height > sizeof(ssd1306_column_t) * 8) {
+		ESP_LOGE(__FUNCTION__, "panel is taller than ssd1306_column_t");
+		return;
+	}
+	if (end >= dev->_width) end = dev->_width - 1;
+	lines = lines % height;
+	if (lines < 0) lines = lines + height;
+	if (lines == 0) return;
+
+	ssd1306_column_t mask = ~(ssd1306_column_t)0;
+	if (height < sizeof(ssd1306_column_t) * 8) mask = ((ssd1306_column_t)1 << height) - 1;
+	uint8_t *frame = dev->_frame;
+	for (int seg=start; seg<=end; seg++) {
+		ssd1306_column_t column = ssd1306_pack_column(dev, frame, dev->_width, seg);
+		column = ((column >> lines) | (column << (height - lines))) & mask;
+		ssd1306_unpack_column(dev, frame, dev->_width, seg, column);
+	}
 }
 
 // delay = 0 : display with no wait
@@ -362,8 +748,8 @@ void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int sta
 		uint8_t wk;
 		//for (int page=0;page<dev->_pages;page++) {
 		for (int page=_start;page<=_end;page++) {
-			wk = dev->_page[page]._segs[127];
-			for (int seg=127;seg>0;seg--) {
+			wk = dev->_page[page]._segs[dev->_width-1];
+			for (int seg=dev->_width-1;seg>0;seg--) {
 				dev->_page[page]._segs[seg] = dev->_page[page]._segs[seg-1];
 			}
 			dev->_page[page]._segs[0] = wk;
@@ -377,239 +763,193 @@ void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int sta
 		//for (int page=0;page<dev->_pages;page++) {
 		for (int page=_start;page<=_end;page++) {
 			wk = dev->_page[page]._segs[0];
-			for (int seg=0;seg<127;seg++) {
+			for (int seg=0;seg<dev->_width-1;seg++) {
 				dev->_page[page]._segs[seg] = dev->_page[page]._segs[seg+1];
 			}
-			dev->_page[page]._segs[127] = wk;
+			dev->_page[page]._segs[dev->_width-1] = wk;
 		}
 
 	} else if (scroll == SCROLL_UP) {
-		int _start = start; // 0 to {width-1}
-		int _end = end; // 0 to {width-1}
-		if (_end >= dev->_width) _end = dev->_width - 1;
-		uint8_t wk0;
-		uint8_t wk1;
-		uint8_t wk2;
-		uint8_t save[128];
-		// Save pages 0
-		for (int seg=0;seg<128;seg++) {
-			save[seg] = dev->_page[0]._segs[seg];
-		}
-		// Page0 to Page6
-		for (int page=0;page<dev->_pages-1;page++) {
-			//for (int seg=0;seg<128;seg++) {
-			for (int seg=_start;seg<=_end;seg++) {
-				wk0 = dev->_page[page]._segs[seg];
-				wk1 = dev->_page[page+1]._segs[seg];
-				if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-				if (dev->_flip) wk1 = ssd1306_rotate_byte(wk1);
-				if (seg == 0) {
-					ESP_LOGD(__FUNCTION__, "b page=%d wk0=%02x wk1=%02x", page, wk0, wk1);
-				}
-				wk0 = wk0 >> 1;
-				wk1 = wk1 & 0x01;
-				wk1 = wk1 << 7;
-				wk2 = wk0 | wk1;
-				if (seg == 0) {
-					ESP_LOGD(__FUNCTION__, "a page=%d wk0=%02x wk1=%02x wk2=%02x", page, wk0, wk1, wk2);
-				}
-				if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-				dev->_page[page]._segs[seg] = wk2;
-			}
-		}
-		// Page7
-		int pages = dev->_pages-1;
-		//for (int seg=0;seg<128;seg++) {
-		for (int seg=_start;seg<=_end;seg++) {
-			wk0 = dev->_page[pages]._segs[seg];
-			wk1 = save[seg];
-			if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-			if (dev->_flip) wk1 = ssd1306_rotate_byte(wk1);
-			wk0 = wk0 >> 1;
-			wk1 = wk1 & 0x01;
-			wk1 = wk1 << 7;
-			wk2 = wk0 | wk1;
-			if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-			dev->_page[pages]._segs[seg] = wk2;
-		}
+		ssd1306_wrap_vertical(dev, start, end, 1);
 
 	} else if (scroll == SCROLL_DOWN) {
-		int _start = start; // 0 to {width-1}
-		int _end = end; // 0 to {width-1}
-		if (_end >= dev->_width) _end = dev->_width - 1;
-		uint8_t wk0;
-		uint8_t wk1;
-		uint8_t wk2;
-		uint8_t save[128];
-		// Save pages 7
-		int pages = dev->_pages-1;
-		for (int seg=0;seg<128;seg++) {
-			save[seg] = dev->_page[pages]._segs[seg];
-		}
-		// Page7 to Page1
-		for (int page=pages;page>0;page--) {
-			//for (int seg=0;seg<128;seg++) {
-			for (int seg=_start;seg<=_end;seg++) {
-				wk0 = dev->_page[page]._segs[seg];
-				wk1 = dev->_page[page-1]._segs[seg];
-				if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-				if (dev->_flip) wk1 = ssd1306_rotate_byte(wk1);
-				if (seg == 0) {
-					ESP_LOGD(__FUNCTION__, "b page=%d wk0=%02x wk1=%02x", page, wk0, wk1);
-				}
-				wk0 = wk0 << 1;
-				wk1 = wk1 & 0x80;
-				wk1 = wk1 >> 7;
-				wk2 = wk0 | wk1;
-				if (seg == 0) {
-					ESP_LOGD(__FUNCTION__, "a page=%d wk0=%02x wk1=%02x wk2=%02x", page, wk0, wk1, wk2);
-				}
-				if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-				dev->_page[page]._segs[seg] = wk2;
-			}
-		}
-		// Page0
-		//for (int seg=0;seg<128;seg++) {
-		for (int seg=_start;seg<=_end;seg++) {
-			wk0 = dev->_page[0]._segs[seg];
-			wk1 = save[seg];
-			if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-			if (dev->_flip) wk1 = ssd1306_rotate_byte(wk1);
-			wk0 = wk0 << 1;
-			wk1 = wk1 & 0x80;
-			wk1 = wk1 >> 7;
-			wk2 = wk0 | wk1;
-			if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-			dev->_page[0]._segs[seg] = wk2;
-		}
+		ssd1306_wrap_vertical(dev, start, end, -1);
 
 	} else if (scroll == PAGE_SCROLL_DOWN) {
-		uint8_t save[128];
+		uint8_t save[SSD1306_MAX_WIDTH];
 		// Save pages 7
-		for (int seg=0;seg<128;seg++) {
+		for (int seg=0;seg<dev->_width;seg++) {
 			save[seg] = dev->_page[dev->_pages-1]._segs[seg];
 		}
 		// Page7 to Page1
 		for (int page=dev->_pages-1;page>0;page--) {
-			for (int seg=0;seg<128;seg++) {
+			for (int seg=0;seg<dev->_width;seg++) {
 				dev->_page[page]._segs[seg] = dev->_page[page-1]._segs[seg];
 			}
 		}
 		// Store  pages 0
-		for (int seg=0;seg<128;seg++) {
+		for (int seg=0;seg<dev->_width;seg++) {
 			dev->_page[0]._segs[seg] = save[seg];
 		}
 
 	} else if (scroll == PAGE_SCROLL_UP) {
-		uint8_t save[128];
+		uint8_t save[SSD1306_MAX_WIDTH];
 		// Save pages 0
-		for (int seg=0;seg<128;seg++) {
+		for (int seg=0;seg<dev->_width;seg++) {
 			save[seg] = dev->_page[0]._segs[seg];
 		}
 		// Page0 to Page6
 		for (int page=0;page<dev->_pages-1;page++) {
-			for (int seg=0;seg<128;seg++) {
+			for (int seg=0;seg<dev->_width;seg++) {
 				dev->_page[page]._segs[seg] = dev->_page[page+1]._segs[seg];
 			}
 		}
 		// Store  pages 7
-		for (int seg=0;seg<128;seg++) {
+		for (int seg=0;seg<dev->_width;seg++) {
 			dev->_page[dev->_pages-1]._segs[seg] = save[seg];
 		}
 	}
 
-	if (delay >= 0) {
+	if (delay == 0) {
+		ssd1306_show_buffer(dev);
+	} else if (delay > 0) {
 		for (int page=0;page<dev->_pages;page++) {
-			if (dev->_address == SPI_ADDRESS) {
-				spi_display_image(dev, page, 0, dev->_page[page]._segs, 128);
-			} else {
-				i2c_display_image(dev, page, 0, dev->_page[page]._segs, 128);
-			}
+			ssd1306_write_panel(dev, page, 0, dev->_page[page]._segs, dev->_width);
 			if (delay) vTaskDelay(delay);
 		}
 	}
 
 }
 
-void _ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
+// Transpose an 8x8 block of bitmap rows (MSB = leftmost pixel) into panel
+// columns: byte 7-x of the result is column x with bit n = row n. With
+// flipped rows the result has row n in bit 7-n instead.
+static uint64_t ssd1306_transpose8(const uint8_t * rows, bool flip)
 {
-	if ( (width % 8) != 0) {
-		ESP_LOGE(__FUNCTION__, "width must be a multiple of 8");
-		return;
+	uint64_t x = 0;
+	for (int row=0; row<8; row++) {
+		int shift = flip ? (7 - row) * 8 : row * 8;
+		x |= (uint64_t)rows[row] << shift;
 	}
-	int _width = width / 8;
-	uint8_t wk0;
-	uint8_t wk1;
-	uint8_t wk2;
-	uint8_t page = (ypos / 8);
-	uint8_t _seg = xpos;
-	uint8_t dstBits = (ypos % 8);
-	ESP_LOGD(__FUNCTION__, "_width=%d ypos=%d page=%d dstBits=%d", _width, ypos, page, dstBits);
-	int offset = 0;
-	for(int _height=0;_height<height;_height++) {
-		for (int index=0;index<_width;index++) {
-			for (int srcBits=7; srcBits>=0; srcBits--) {
-				wk0 = dev->_page[page]._segs[_seg];
-				if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-
-				wk1 = bitmap[index+offset];
-				if (invert) wk1 = ~wk1;
-
-				//wk2 = ssd1306_copy_bit(bitmap[index+offset], srcBits, wk0, dstBits);
-				wk2 = ssd1306_copy_bit(wk1, srcBits, wk0, dstBits);
-				if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-
-				ESP_LOGD(__FUNCTION__, "index=%d offset=%d wk1=0x%x page=%d _seg=%d, wk2=%02x", index, offset, wk1, page, _seg, wk2);
-				if (_seg >= 128) {
-					ESP_LOGW(__FUNCTION__, "segment is out of range");
-					break;
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+static void ssd1306_rop_byte(uint8_t * dst, uint8_t src, uint8_t mask, ssd1306_rop_t rop)
+{
+	switch (rop) {
+	case SSD1306_ROP_COPY:
+		*dst = (*dst & ~mask) | (src & mask);
+		break;
+	case SSD1306_ROP_OR:
+		*dst |= src & mask;
+		break;
+	case SSD1306_ROP_AND:
+		*dst &= src | ~mask;
+		break;
+	case SSD1306_ROP_XOR:
+		*dst ^= src & mask;
+		break;
+	}
+}
+
+// Draw a row-major bitmap (MSB first, rows padded to whole bytes) into the
+// internal buffer. Works on 8x8 blocks: eight source rows are transposed into
+// eight column bytes at once, then each column byte is shifted into the one
+// or two pages it straddles. Anything outside the panel is clipped.
+void _ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert)
+{
+	if (width <= 0 || height <= 0) return;
+	if (xpos >= dev->_width || xpos + width <= 0) return;
+	if (ypos >= dev->_pages * 8 || ypos + height <= 0) return;
+
+	int stride = (width + 7) / 8;
+	bool flip = dev->_flip;
+	// Rows of band 0 start shift bits into page0
+	int page0 = (ypos >= 0) ? ypos / 8 : -((7 - ypos) / 8);
+	int shift = ypos - page0 * 8;
+
+	// Only the bands and byte columns that can reach the panel
+	int band_first = 0;
+	if (ypos < 0) band_first = (-ypos) / 8;
+	int band_last = (height - 1) / 8;
+	if ((dev->_pages * 8 - 1 - ypos) / 8 < band_last) band_last = (dev->_pages * 8 - 1 - ypos) / 8;
+	int index_first = (xpos < 0) ? (-xpos) / 8 : 0;
+	int index_last = stride - 1;
+	if ((dev->_width - 1 - xpos) / 8 < index_last) index_last = (dev->_width - 1 - xpos) / 8;
+
+	for (int band=band_first; band<=band_last; band++) {
+		int rows = height - band * 8;
+		if (rows > 8) rows = 8;
+		// Valid rows of this band, in column byte order
+		uint8_t valid = (rows == 8) ? 0xFF : (1 << rows) - 1;
+		if (flip) valid = ssd1306_rotate_byte(valid);
+
+		int page = page0 + band;
+		for (int index=index_first; index<=index_last; index++) {
+			uint8_t block[8] = {0};
+			for (int row=0; row<rows; row++) {
+				block[row] = bitmap[(band * 8 + row) * stride + index];
+			}
+			uint64_t columns = ssd1306_transpose8(block, flip);
+
+			for (int bit=0; bit<8; bit++) {
+				int x = index * 8 + bit;
+				int seg = xpos + x;
+				if (x >= width) break;
+				if (seg < 0) continue;
+				if (seg >= dev->_width) break;
+
+				uint8_t col = columns >> ((7 - bit) * 8);
+				if (invert) col = ~col;
+				// Top rows are the low bits, or the high bits when flipped
+				if (page >= 0 && page < dev->_pages) {
+					uint8_t src = flip ? col >> shift : col << shift;
+					uint8_t mask = flip ? valid >> shift : valid << shift;
+					ssd1306_rop_byte(&dev->_page[page]._segs[seg], src, mask, rop);
 				}
-				if (page >= dev->_pages) {
-					ESP_LOGW(__FUNCTION__, "page is out of range");
-					break;
+				if (shift != 0 && page + 1 >= 0 && page + 1 < dev->_pages) {
+					uint8_t src = flip ? col << (8 - shift) : col >> (8 - shift);
+					uint8_t mask = flip ? valid << (8 - shift) : valid >> (8 - shift);
+					ssd1306_rop_byte(&dev->_page[page + 1]._segs[seg], src, mask, rop);
 				}
-				dev->_page[page]._segs[_seg] = wk2;
-				_seg++;
 			}
 		}
-		//vTaskDelay(1);
-		offset = offset + _width;
-		dstBits++;
-		_seg = xpos;
-		if (dstBits == 8) {
-			page++;
-			dstBits=0;
-		}
 	}
 
-#if 0
-	for (int _seg=ypos;_seg<ypos+width;_seg++) {
-		ssd1306_dump_page(dev, page-1, _seg);
-	}
-	for (int _seg=ypos;_seg<ypos+width;_seg++) {
-		ssd1306_dump_page(dev, page, _seg);
+	int page_last = (ypos + height - 1) / 8;
+	for (int page=(ypos < 0 ? 0 : ypos / 8); page<=page_last; page++) {
+		ssd1306_mark_dirty(dev, page, xpos, width);
 	}
-#endif
-	//ssd1306_show_buffer(dev);
+}
+
+void _ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
+{
+	_ssd1306_blit(dev, xpos, ypos, bitmap, width, height, SSD1306_ROP_COPY, invert);
 }
 
 
 void ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
 {
 	_ssd1306_bitmaps(dev, xpos, ypos, bitmap, width, height, invert);
-	
-	// Calculate the range of pages and segments to update
-	int start_page = ypos / 8;
+
+	// Update only the pages and segments the clipped bitmap covers
+	int start_page = (ypos < 0) ? 0 : ypos / 8;
 	int end_page = (ypos + height - 1) / 8;
-	int start_seg = xpos;
+	int start_seg = (xpos < 0) ? 0 : xpos;
 	int end_seg = xpos + width - 1;
+	if (end_page >= dev->_pages) end_page = dev->_pages - 1;
+	if (end_seg >= dev->_width) end_seg = dev->_width - 1;
+	if (ypos + height <= 0 || end_seg < start_seg) return;
 
-	// Update only the modified pages and segments
 	for (int page = start_page; page <= end_page; page++) {
-		int seg_start = (page == start_page) ? start_seg : 0;
-		int seg_end = (page == end_page) ? end_seg : 127;
-		int seg_width = seg_end - seg_start + 1;
-		ssd1306_display_image(dev, page, seg_start, &dev->_page[page]._segs[seg_start], seg_width);
+		ssd1306_write_panel(dev, page, start_seg, &dev->_page[page]._segs[start_seg], end_seg - start_seg + 1);
 	}
 }
 
@@ -631,6 +971,7 @@ void _ssd1306_pixel(SSD1306_t * dev, int xpos, int ypos, bool invert)
 	if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
 	ESP_LOGD(__FUNCTION__, "wk0=0x%02x wk1=0x%02x", wk0, wk1);
 	dev->_page[_page]._segs[_seg] = wk0;
+	ssd1306_mark_dirty(dev, _page, _seg, 1);
 }
 
 // Set line to internal buffer. Not show it.
@@ -794,32 +1135,6 @@ uint8_t ssd1306_rotate_byte(uint8_t ch1) {
 }
 
 
-void ssd1306_fadeout(SSD1306_t * dev)
-{
-	void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-	if (dev->_address == SPI_ADDRESS) {
-		func = spi_display_image;
-	} else {
-		func = i2c_display_image;
-	}
-
-	uint8_t image[1];
-	for(int page=0; page<dev->_pages; page++) {
-		image[0] = 0xFF;
-		for(int line=0; line<8; line++) {
-			if (dev->_flip) {
-				image[0] = image[0] >> 1;
-			} else {
-				image[0] = image[0] << 1;
-			}
-			for(int seg=0; seg<128; seg++) {
-				(*func)(dev, page, seg, image, 1);
-				dev->_page[page]._segs[seg] = image[0];
-			}
-		}
-	}
-}
-
 // Rotate character image
 // Only valid for 8 dots x 8 dots
 void ssd1306_rotate_image(uint8_t *image, bool flip) {
@@ -852,18 +1167,17 @@ void ssd1306_rotate_image(uint8_t *image, bool flip) {
 
 void ssd1306_display_rotate_text(SSD1306_t * dev, int seg, const char * text, int text_len, bool invert) {
 	int _text_len = text_len;
-	if (_text_len > 8) _text_len = 8;
-	uint8_t image[8];
+	if (_text_len > dev->_pages) _text_len = dev->_pages;
+	int flags = ssd1306_text_flags(dev, invert) | SSD1306_GLYPH_ROTATE;
 	int _page = dev->_pages-1;
 	for (uint8_t i = 0; i < _text_len; i++) {
-		memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
-		ssd1306_rotate_image(image, dev->_flip);
 		ESP_LOGD(__FUNCTION__, "_page=%d seg=%d", _page, seg);
-		if (invert) ssd1306_invert(image, 8);
-		ssd1306_display_image(dev, _page, seg, image, 8);
+		memcpy(&dev->_page[_page]._segs[seg], ssd1306_glyph(text[i], flags), 8);
+		ssd1306_mark_dirty(dev, _page, seg, 8);
 		_page--;
-		if (_page < 0) return;
+		if (_page < 0) break;
 	}
+	ssd1306_flush_dirty(dev);
 }
 
 void ssd1306_dump(SSD1306_t dev)
@@ -879,3 +1193,13 @@ void ssd1306_dump_page(SSD1306_t * dev, int page, int seg)
 	ESP_LOGI(__FUNCTION__, "dev->_page[%d]._segs[%d]=%02x", page, seg, dev->_page[page]._segs[seg]);
 }
 
+#if CONFIG_SSD1306_BUS_STATS
+// Bus traffic since the previous call. Not atomic against the flush task,
+// read it when no transfer is in flight.
+ssd1306_bus_stats_t ssd1306_take_bus_stats(SSD1306_t * dev)
+{
+	ssd1306_bus_stats_t stats = dev->_busStats;
+	memset(&dev->_busStats, 0, sizeof(stats));
+	return stats;
+}
+#endif
@@ -1,12 +1,25 @@
 #ifndef MAIN_SSD1306_H_
 #define MAIN_SSD1306_H_
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#if CONFIG_SSD1306_VIRTUAL
+#include "esp_err.h"
+#include "esp_idf_version.h"
+// No bus on the host, the handle types only keep SSD1306_t the same
+typedef int i2c_port_t;
+typedef void * spi_device_handle_t;
+typedef void * i2c_master_bus_handle_t;
+typedef void * i2c_master_dev_handle_t;
+#else
 #include "driver/spi_master.h"
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
 #include "driver/i2c_master.h"
 #else
 #include "driver/i2c.h"
 #endif
+#endif
 
 // Following definitions are bollowed from 
 // http://robotcantalk.blogspot.com/2015/03/interfacing-arduino-with-ssd1306-driven.html
@@ -73,9 +86,23 @@ Usage:
 #define OLED_CMD_ACTIVE_SCROLL          0x2F
 #define OLED_CMD_VERTICAL               0xA3
 
+// Per-device scratch space for one panel transfer, so the display path never
+// touches the heap. The new i2c driver stages the addressing header here, the
+// legacy driver builds its static command link in it.
+#define SSD1306_XFER_SIZE 408
+
+// Largest panel the controller drives, actual sizes are set per device
+#define SSD1306_MAX_WIDTH 128
+#define SSD1306_MAX_PAGES 8
+
 #define I2C_ADDRESS 0x3C
 #define SPI_ADDRESS 0xFF
 
+// Glyph variants for ssd1306_glyph
+#define SSD1306_GLYPH_INVERT 0x01
+#define SSD1306_GLYPH_FLIP   0x02
+#define SSD1306_GLYPH_ROTATE 0x04
+
 #define OLED_DRAW_UPPER_RIGHT 0x01
 #define OLED_DRAW_UPPER_LEFT  0x02
 #define OLED_DRAW_LOWER_LEFT  0x04
@@ -92,32 +119,136 @@ typedef enum {
 	SCROLL_STOP = 7
 } ssd1306_scroll_type_t;
 
+// One display column, bit n = pixel row n
+#if CONFIG_SSD1306_128x32
+typedef uint32_t ssd1306_column_t;
+#else
+typedef uint64_t ssd1306_column_t;
+#endif
+
+typedef enum {
+	SSD1306_ROP_COPY = 0,
+	SSD1306_ROP_OR = 1,
+	SSD1306_ROP_AND = 2,
+	SSD1306_ROP_XOR = 3
+} ssd1306_rop_t;
+
 typedef struct {
 	bool _valid; // Not using it anymore
 	int _segLen; // Not using it anymore
-	uint8_t _segs[128];
+	uint8_t * _segs; // _width bytes of the device frame
 } PAGE_t;
 
+// Display writes counted by the transport (CONFIG_SSD1306_BUS_STATS), with
+// the time they take on the wire at the bus clock
+typedef struct {
+	uint32_t transactions; // START/address phases (I2C) or chip selects (SPI)
+	uint32_t bytes; // Everything after the address, control bytes included
+	uint64_t wire_ns;
+} ssd1306_bus_stats_t;
+
+#define SSD1306_I2C_FREQ_HZ 400000 // I2C clock of SSD1306 can run at 400 kHz max.
+// START, address, 9 clocks per byte (ACK), STOP
+#define SSD1306_I2C_WIRE_NS(bytes) ((uint64_t)(((bytes) + 1) * 9 + 2) * 1000000000ULL / SSD1306_I2C_FREQ_HZ)
+#define SSD1306_SPI_WIRE_NS(bytes, hz) ((uint64_t)(bytes) * 8 * 1000000000ULL / (hz))
+
+#if CONFIG_SSD1306_VIRTUAL
+typedef struct ssd1306_virtual ssd1306_virtual_t;
+
+// Bus cost recorded by the virtual panel
+typedef struct {
+	uint32_t transactions; // One START/address phase each
+	uint32_t bytes; // Control, command and data bytes after the address
+	uint32_t commands; // Decoded commands, parameters included in one
+	uint32_t data; // Bytes written to GDDRAM
+} ssd1306_virtual_stats_t;
+#endif
+
 typedef struct {
 	int _address;
 	int _width;
 	int _height;
 	int _pages;
+	int _offsetx; // Panel column of the first visible segment
 	int _dc;
 	bool _scEnable;
 	int _scStart;
 	int _scEnd;
 	int _scDirection;
-	PAGE_t _page[8];
+	PAGE_t _page[SSD1306_MAX_PAGES];
+	uint8_t * _frame; // Internal buffer, _pages * _width bytes
+	uint8_t * _shadow; // What the panel currently holds, same layout
+	bool _shadowValid;
+	int _dirtyStart[SSD1306_MAX_PAGES]; // Columns changed since the last flush, per page
+	int _dirtyEnd[SSD1306_MAX_PAGES]; // (start > end when clean)
 	bool _flip;
+	bool _burst; // ssd1306_show_buffer may stream rectangles
+	bool _horizontal; // Panel is in Horizontal Addressing Mode
+	uint8_t _xfer[SSD1306_XFER_SIZE];
+	uint8_t * _dma_buf; // Contiguous DMA buffer for SPI bursts
+	PAGE_t * _pending; // Front buffer waiting for the flush task
+	PAGE_t * _sending; // Front buffer the flush task is sending
+	bool _pendingValid;
+	SemaphoreHandle_t _flushMutex;
+	SemaphoreHandle_t _busMutex; // Held by the flush task while it sends
+	TaskHandle_t _flushTask;
 	i2c_port_t _i2c_num;
 	spi_device_handle_t _spi_device_handle;
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
 	i2c_master_bus_handle_t _i2c_bus_handle;
 	i2c_master_dev_handle_t _i2c_dev_handle;
 #endif
+#if CONFIG_SSD1306_VIRTUAL
+	ssd1306_virtual_t * _virtual; // Simulated controller
+#endif
+#if CONFIG_SSD1306_BUS_STATS
+	ssd1306_bus_stats_t _busStats; // Since the last ssd1306_take_bus_stats
+#endif
 } SSD1306_t;
 
+// Called by the transports for every transfer
+#if CONFIG_SSD1306_BUS_STATS
+static inline void ssd1306_bus_account(SSD1306_t * dev, size_t bytes, uint64_t wire_ns) {
+	dev->_busStats.transactions++;
+	dev->_busStats.bytes += bytes;
+	dev->_busStats.wire_ns += wire_ns;
+}
+#else
+static inline void ssd1306_bus_account(SSD1306_t * dev, size_t bytes, uint64_t wire_ns) {}
+#endif
+
+#define SSD1306_ANIM_DEFAULT_FPS 60
+
+typedef enum {
+	SSD1306_ANIM_FADEOUT = 1, // Curtain down to a blank screen
+	SSD1306_ANIM_DISSOLVE = 2, // Ordered dither from the current to the target frame
+	SSD1306_ANIM_WIPE_LEFT = 3,
+	SSD1306_ANIM_WIPE_RIGHT = 4,
+	SSD1306_ANIM_WIPE_DOWN = 5,
+	SSD1306_ANIM_SLIDE_LEFT = 6,
+	SSD1306_ANIM_SLIDE_RIGHT = 7,
+	SSD1306_ANIM_SLIDE_UP = 8,
+	SSD1306_ANIM_SLIDE_DOWN = 9,
+	SSD1306_ANIM_CONTRAST = 10,
+	SSD1306_ANIM_WRAP = 11 // ssd1306_wrap_arround every frame
+} ssd1306_anim_type_t;
+
+typedef struct {
+	ssd1306_anim_type_t _type;
+	int _frame;
+	int _frames;
+	TickType_t _period;
+	TickType_t _last;
+	bool _running;
+	uint8_t _from[SSD1306_MAX_PAGES][SSD1306_MAX_WIDTH];
+	const uint8_t * _to;
+	int _contrastFrom;
+	int _contrastTo;
+	ssd1306_scroll_type_t _scroll;
+	int _start;
+	int _end;
+} ssd1306_anim_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -128,14 +259,25 @@ int ssd1306_get_width(SSD1306_t * dev);
 int ssd1306_get_height(SSD1306_t * dev);
 int ssd1306_get_pages(SSD1306_t * dev);
 void ssd1306_show_buffer(SSD1306_t * dev);
+void ssd1306_invalidate(SSD1306_t * dev);
+void ssd1306_set_burst(SSD1306_t * dev, bool enable);
+void ssd1306_show_rect(SSD1306_t * dev, int page, int seg, int pages, int width);
+bool ssd1306_start_flush_task(SSD1306_t * dev, UBaseType_t priority);
+void ssd1306_swap_buffer(SSD1306_t * dev);
+void ssd1306_mark_dirty(SSD1306_t * dev, int page, int seg, int width);
+void ssd1306_clear_dirty(SSD1306_t * dev);
+void ssd1306_flush_dirty(SSD1306_t * dev);
 void ssd1306_set_buffer(SSD1306_t * dev, const uint8_t * buffer);
 void ssd1306_get_buffer(SSD1306_t * dev, uint8_t * buffer);
 void ssd1306_set_page(SSD1306_t * dev, int page, const uint8_t * buffer);
 void ssd1306_get_page(SSD1306_t * dev, int page, uint8_t * buffer);
 void ssd1306_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+const uint8_t * ssd1306_glyph(uint8_t ch, int flags);
+void _ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
 void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
 void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
+void _ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
 void ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
 void ssd1306_clear_screen(SSD1306_t * dev, bool invert);
 void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert);
@@ -145,6 +287,10 @@ void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool
 void ssd1306_scroll_clear(SSD1306_t * dev);
 void ssd1306_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int start, int end, int8_t delay);
+void ssd1306_wrap_vertical(SSD1306_t * dev, int start, int end, int lines);
+ssd1306_column_t ssd1306_pack_column(SSD1306_t * dev, const uint8_t * frame, int stride, int seg);
+void ssd1306_unpack_column(SSD1306_t * dev, uint8_t * frame, int stride, int seg, ssd1306_column_t column);
+void _ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert);
 void _ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert);
 void ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert);
 void _ssd1306_pixel(SSD1306_t * dev, int xpos, int ypos, bool invert);
@@ -157,17 +303,36 @@ void ssd1306_flip(uint8_t *buf, size_t blen);
 uint8_t ssd1306_copy_bit(uint8_t src, int srcBits, uint8_t dst, int dstBits);
 uint8_t ssd1306_rotate_byte(uint8_t ch1);
 void ssd1306_fadeout(SSD1306_t * dev);
+void ssd1306_anim_begin(SSD1306_t * dev, ssd1306_anim_t * anim, ssd1306_anim_type_t type, const uint8_t * target, int frames, int fps);
+void ssd1306_anim_contrast(SSD1306_t * dev, ssd1306_anim_t * anim, int from, int to, int frames, int fps);
+void ssd1306_anim_wrap(SSD1306_t * dev, ssd1306_anim_t * anim, ssd1306_scroll_type_t scroll, int start, int end, int frames, int fps);
+bool ssd1306_anim_step(SSD1306_t * dev, ssd1306_anim_t * anim);
+void ssd1306_anim_run(SSD1306_t * dev, ssd1306_anim_t * anim);
+void ssd1306_anim_stop(ssd1306_anim_t * anim);
 void ssd1306_rotate_image(uint8_t *image, bool flip);
 void ssd1306_display_rotate_text(SSD1306_t * dev, int seg, const char * text, int text_len, bool invert);
 void ssd1306_dump(SSD1306_t dev);
 void ssd1306_dump_page(SSD1306_t * dev, int page, int seg);
+#if CONFIG_SSD1306_BUS_STATS
+ssd1306_bus_stats_t ssd1306_take_bus_stats(SSD1306_t * dev);
+#endif
 
 void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset);
 void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address);
 void i2c_init(SSD1306_t * dev, int width, int height);
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void i2c_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width);
 void i2c_contrast(SSD1306_t * dev, int contrast);
 void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
+esp_err_t i2c_transmit(SSD1306_t * dev, const uint8_t * buf, size_t len);
+
+#if CONFIG_SSD1306_VIRTUAL
+bool ssd1306_virtual_pixel(SSD1306_t * dev, int x, int y);
+bool ssd1306_virtual_dump_pbm(SSD1306_t * dev, const char * path);
+const uint8_t * ssd1306_virtual_ram(SSD1306_t * dev);
+int ssd1306_virtual_contrast(SSD1306_t * dev);
+ssd1306_virtual_stats_t ssd1306_virtual_take_stats(SSD1306_t * dev);
+#endif
 
 void spi_clock_speed(int speed);
 void spi_master_init(SSD1306_t * dev, int16_t mosi, int16_t sclk, int16_t cs, int16_t dc, int16_t reset);
@@ -178,6 +343,7 @@ bool spi_master_write_command(SSD1306_t * dev, uint8_t Command );
 bool spi_master_write_data(SSD1306_t * dev, const uint8_t* Data, size_t DataLength );
 void spi_init(SSD1306_t * dev, int width, int height);
 void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void spi_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width);
 void spi_contrast(SSD1306_t * dev, int contrast);
 void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
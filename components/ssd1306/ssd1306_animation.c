@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include "ssd1306.h"
+
+// Every frame is computed in the internal buffer and sent with one
+// ssd1306_show_buffer, which only transfers what changed since the last frame.
+
+// 4x4 ordered dither thresholds used by SSD1306_ANIM_DISSOLVE
+static const uint8_t bayer4[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+// Byte of the from/to buffers, blank when there is no target
+static uint8_t anim_byte(SSD1306_t * dev, ssd1306_anim_t * anim, bool target, int page, int seg)
+{
+	if (target == false) return anim->_from[page][seg];
+	if (anim->_to == NULL) return 0;
+	return anim->_to[page * dev->_width + seg];
+}
+
+// Mask of the first rows of a page, in panel bit order
+static uint8_t anim_row_mask(SSD1306_t * dev, int page, int rows)
+{
+	int n = rows - page * 8;
+	if (n <= 0) return 0x00;
+	if (n >= 8) return 0xFF;
+	uint8_t mask = (1 << n) - 1;
+	if (dev->_flip) mask = ssd1306_rotate_byte(mask);
+	return mask;
+}
+
+// Clear the first rows of the screen and light the rest of the page the
+// boundary is in. Rendered in place, pages below the boundary are untouched.
+static void anim_curtain(SSD1306_t * dev, int rows)
+{
+	for (int page=0; page<dev->_pages; page++) {
+		if (page * 8 >= rows) break;
+		uint8_t image = (page * 8 + 8 <= rows) ? 0x00 : ~anim_row_mask(dev, page, rows);
+		memset(dev->_page[page]._segs, image, dev->_width);
+	}
+}
+
+static void anim_render(SSD1306_t * dev, ssd1306_anim_t * anim)
+{
+	int width = dev->_width;
+	int height = dev->_pages * 8;
+	int frame = anim->_frame;
+	int frames = anim->_frames;
+
+	switch (anim->_type) {
+	case SSD1306_ANIM_FADEOUT:
+		anim_curtain(dev, height * frame / frames);
+		break;
+
+	case SSD1306_ANIM_DISSOLVE: {
+		int level = 16 * frame / frames;
+		uint8_t mask[4];
+		for (int x=0; x<4; x++) {
+			mask[x] = 0;
+			for (int row=0; row<8; row++) {
+				if (bayer4[row & 3][x] < level) mask[x] |= (1 << row);
+			}
+		}
+		for (int page=0; page<dev->_pages; page++) {
+			for (int seg=0; seg<width; seg++) {
+				uint8_t m = mask[seg & 3];
+				dev->_page[page]._segs[seg] = (anim_byte(dev, anim, false, page, seg) & ~m) | (anim_byte(dev, anim, true, page, seg) & m);
+			}
+		}
+		break;
+	}
+
+	case SSD1306_ANIM_WIPE_RIGHT:
+	case SSD1306_ANIM_WIPE_LEFT: {
+		int boundary = width * frame / frames;
+		for (int page=0; page<dev->_pages; page++) {
+			for (int seg=0; seg<width; seg++) {
+				bool target = (anim->_type == SSD1306_ANIM_WIPE_RIGHT) ? (seg < boundary) : (seg >= width - boundary);
+				dev->_page[page]._segs[seg] = anim_byte(dev, anim, target, page, seg);
+			}
+		}
+		break;
+	}
+
+	case SSD1306_ANIM_WIPE_DOWN: {
+		int boundary = height * frame / frames;
+		for (int page=0; page<dev->_pages; page++) {
+			uint8_t m = anim_row_mask(dev, page, boundary);
+			for (int seg=0; seg<width; seg++) {
+				dev->_page[page]._segs[seg] = (anim_byte(dev, anim, false, page, seg) & ~m) | (anim_byte(dev, anim, true, page, seg) & m);
+			}
+		}
+		break;
+	}
+
+	case SSD1306_ANIM_SLIDE_LEFT:
+	case SSD1306_ANIM_SLIDE_RIGHT: {
+		int offset = width * frame / frames;
+		for (int page=0; page<dev->_pages; page++) {
+			for (int seg=0; seg<width; seg++) {
+				int x;
+				if (anim->_type == SSD1306_ANIM_SLIDE_LEFT) {
+					x = seg + offset;
+				} else {
+					x = seg + width - offset;
+				}
+				// x indexes the from buffer followed by the to buffer (left)
+				// or the to buffer followed by the from buffer (right)
+				bool target = (x >= width);
+				if (anim->_type == SSD1306_ANIM_SLIDE_RIGHT) target = !target;
+				dev->_page[page]._segs[seg] = anim_byte(dev, anim, target, page, x % width);
+			}
+		}
+		break;
+	}
+
+	case SSD1306_ANIM_SLIDE_UP:
+	case SSD1306_ANIM_SLIDE_DOWN: {
+		int offset = height * frame / frames;
+		ssd1306_column_t mask = ~(ssd1306_column_t)0;
+		if (height < sizeof(ssd1306_column_t) * 8) mask = ((ssd1306_column_t)1 << height) - 1;
+		for (int seg=0; seg<width; seg++) {
+			// Whole columns: from moves out, to moves in behind it
+			ssd1306_column_t from = ssd1306_pack_column(dev, anim->_from[0], SSD1306_MAX_WIDTH, seg);
+			ssd1306_column_t to = 0;
+			if (anim->_to != NULL) to = ssd1306_pack_column(dev, anim->_to, dev->_width, seg);
+			ssd1306_column_t column;
+			if (offset == 0) {
+				column = from;
+			} else if (offset >= height) {
+				column = to;
+			} else if (anim->_type == SSD1306_ANIM_SLIDE_UP) {
+				column = (from >> offset) | (to << (height - offset));
+			} else {
+				column = (from << offset) | (to >> (height - offset));
+			}
+			ssd1306_unpack_column(dev, dev->_frame, dev->_width, seg, column & mask);
+		}
+		break;
+	}
+
+	case SSD1306_ANIM_CONTRAST: {
+		int contrast = anim->_contrastFrom + (anim->_contrastTo - anim->_contrastFrom) * frame / frames;
+		ssd1306_contrast(dev, contrast);
+		break;
+	}
+
+	case SSD1306_ANIM_WRAP:
+		ssd1306_wrap_arround(dev, anim->_scroll, anim->_start, anim->_end, -1);
+		break;
+	}
+}
+
+static void anim_setup(ssd1306_anim_t * anim, ssd1306_anim_type_t type, int frames, int fps)
+{
+	if (frames < 1) frames = 1;
+	if (fps < 1) fps = SSD1306_ANIM_DEFAULT_FPS;
+	anim->_type = type;
+	anim->_frame = 0;
+	anim->_frames = frames;
+	anim->_period = pdMS_TO_TICKS(1000 / fps);
+	if (anim->_period == 0) anim->_period = 1;
+	anim->_running = true;
+}
+
+// Transition from the current buffer to target (pages*width bytes as for
+// ssd1306_set_buffer, NULL for a blank screen). target must stay valid until
+// the animation ends.
+void ssd1306_anim_begin(SSD1306_t * dev, ssd1306_anim_t * anim, ssd1306_anim_type_t type, const uint8_t * target, int frames, int fps)
+{
+	anim_setup(anim, type, frames, fps);
+	anim->_to = target;
+	for (int page=0; page<dev->_pages; page++) {
+		memcpy(anim->_from[page], dev->_page[page]._segs, dev->_width);
+	}
+}
+
+// Ramp the contrast, the buffer is not touched
+void ssd1306_anim_contrast(SSD1306_t * dev, ssd1306_anim_t * anim, int from, int to, int frames, int fps)
+{
+	anim_setup(anim, SSD1306_ANIM_CONTRAST, frames, fps);
+	anim->_contrastFrom = from;
+	anim->_contrastTo = to;
+}
+
+// Run ssd1306_wrap_arround once per frame
+void ssd1306_anim_wrap(SSD1306_t * dev, ssd1306_anim_t * anim, ssd1306_scroll_type_t scroll, int start, int end, int frames, int fps)
+{
+	anim_setup(anim, SSD1306_ANIM_WRAP, frames, fps);
+	anim->_scroll = scroll;
+	anim->_start = start;
+	anim->_end = end;
+}
+
+// Non-blocking: render and send the next frame when it is due.
+// Returns false once the animation has finished.
+bool ssd1306_anim_step(SSD1306_t * dev, ssd1306_anim_t * anim)
+{
+	if (anim->_running == false) return false;
+	TickType_t now = xTaskGetTickCount();
+	if (anim->_frame > 0 && (now - anim->_last) < anim->_period) return true;
+	anim->_last = now;
+
+	anim->_frame++;
+	anim_render(dev, anim);
+	if (anim->_type != SSD1306_ANIM_CONTRAST) ssd1306_show_buffer(dev);
+	ESP_LOGD(__FUNCTION__, "type=%d frame=%d/%d", anim->_type, anim->_frame, anim->_frames);
+	if (anim->_frame >= anim->_frames) anim->_running = false;
+	return anim->_running;
+}
+
+// Blocking: play the whole animation at its frame rate
+void ssd1306_anim_run(SSD1306_t * dev, ssd1306_anim_t * anim)
+{
+	TickType_t last = xTaskGetTickCount();
+	while (anim->_running) {
+		anim->_frame++;
+		anim_render(dev, anim);
+		if (anim->_type != SSD1306_ANIM_CONTRAST) ssd1306_show_buffer(dev);
+		if (anim->_frame >= anim->_frames) {
+			anim->_running = false;
+			break;
+		}
+		vTaskDelayUntil(&last, anim->_period);
+	}
+}
+
+void ssd1306_anim_stop(ssd1306_anim_t * anim)
+{
+	anim->_running = false;
+}
+
+void ssd1306_fadeout(SSD1306_t * dev)
+{
+	// One frame per pixel row, the curtain needs no copy of the buffer
+	int frames = dev->_pages * 8;
+	TickType_t period = pdMS_TO_TICKS(1000 / SSD1306_ANIM_DEFAULT_FPS);
+	if (period == 0) period = 1;
+	TickType_t last = xTaskGetTickCount();
+	for (int rows=1; rows<=frames; rows++) {
+		anim_curtain(dev, rows);
+		ssd1306_show_buffer(dev);
+		if (rows < frames) vTaskDelayUntil(&last, period);
+	}
+}
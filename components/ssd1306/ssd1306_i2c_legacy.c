@@ -18,9 +18,12 @@
 #define I2C_NUM I2C_NUM_0 // if spi is selected
 #endif
 
-#define I2C_MASTER_FREQ_HZ 400000 // I2C clock of SSD1306 can run at 400 kHz max.
+#define I2C_MASTER_FREQ_HZ SSD1306_I2C_FREQ_HZ
 #define I2C_TICKS_TO_WAIT 100	  // Maximum ticks to wait before issuing a timeout.
 
+// A burst links START, address, header, up to 8 pages and STOP
+_Static_assert(SSD1306_XFER_SIZE >= I2C_LINK_RECOMMENDED_SIZE(3), "SSD1306_XFER_SIZE too small for a static command link");
+
 void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset)
 {
 	ESP_LOGI(TAG, "Legacy i2c driver is used");
@@ -46,6 +49,7 @@ void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset)
 
 	dev->_address = I2C_ADDRESS;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_i2c_num = I2C_NUM;
 }
 
@@ -77,14 +81,15 @@ void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t
 
 	dev->_address = i2c_address;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_i2c_num = i2c_num;
 }
 
 void i2c_init(SSD1306_t * dev, int width, int height) {
 	dev->_width = width;
 	dev->_height = height;
-	dev->_pages = 8;
-	if (dev->_height == 32) dev->_pages = 4;
+	dev->_pages = (height + 7) / 8;
+	dev->_horizontal = false;
 	
 	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
 
@@ -93,8 +98,7 @@ void i2c_init(SSD1306_t * dev, int width, int height) {
 	i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
 	i2c_master_write_byte(cmd, OLED_CMD_DISPLAY_OFF, true);				// AE
 	i2c_master_write_byte(cmd, OLED_CMD_SET_MUX_RATIO, true);			// A8
-	if (dev->_height == 64) i2c_master_write_byte(cmd, 0x3F, true);
-	if (dev->_height == 32) i2c_master_write_byte(cmd, 0x1F, true);
+	i2c_master_write_byte(cmd, dev->_height - 1, true);
 	i2c_master_write_byte(cmd, OLED_CMD_SET_DISPLAY_OFFSET, true);		// D3
 	i2c_master_write_byte(cmd, 0x00, true);
 	//i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_DATA_STREAM, true);	// 40
@@ -109,8 +113,8 @@ void i2c_init(SSD1306_t * dev, int width, int height) {
 	i2c_master_write_byte(cmd, OLED_CMD_SET_DISPLAY_CLK_DIV, true);		// D5
 	i2c_master_write_byte(cmd, 0x80, true);
 	i2c_master_write_byte(cmd, OLED_CMD_SET_COM_PIN_MAP, true);			// DA
-	if (dev->_height == 64) i2c_master_write_byte(cmd, 0x12, true);
-	if (dev->_height == 32) i2c_master_write_byte(cmd, 0x02, true);
+	// Sequential COM pins only on 32 row panels
+	i2c_master_write_byte(cmd, (dev->_height == 32) ? 0x02 : 0x12, true);
 	i2c_master_write_byte(cmd, OLED_CMD_SET_CONTRAST, true);			// 81
 	i2c_master_write_byte(cmd, 0xFF, true);
 	i2c_master_write_byte(cmd, OLED_CMD_DISPLAY_RAM, true);				// A4
@@ -145,7 +149,7 @@ void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 	if (page >= dev->_pages) return;
 	if (seg >= dev->_width) return;
 
-	int _seg = seg + CONFIG_OFFSETX;
+	int _seg = seg + dev->_offsetx;
 	uint8_t columLow = _seg & 0x0F;
 	uint8_t columHigh = (_seg >> 4) & 0x0F;
 
@@ -154,37 +158,102 @@ void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 		_page = (dev->_pages - page) - 1;
 	}
 
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (dev->_address << 1) | I2C_MASTER_WRITE, true);
-
-	i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
+	// Every command byte gets its own control byte (Co=1), so the data stream
+	// can follow in the same transaction: one START/address phase per write.
+	uint8_t header[11];
+	int header_len = 0;
+	if (dev->_horizontal) {
+		// Back from a burst
+		header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		header[header_len++] = OLED_CMD_SET_MEMORY_ADDR_MODE;	// 20
+		header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		header[header_len++] = OLED_CMD_SET_PAGE_ADDR_MODE;		// 02
+		dev->_horizontal = false;
+	}
+	header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Lower Column Start Address for Page Addressing Mode
-	i2c_master_write_byte(cmd, (0x00 + columLow), true);
+	header[header_len++] = (0x00 + columLow);
+	header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Higher Column Start Address for Page Addressing Mode
-	i2c_master_write_byte(cmd, (0x10 + columHigh), true);
+	header[header_len++] = (0x10 + columHigh);
+	header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Page Start Address for Page Addressing Mode
-	i2c_master_write_byte(cmd, 0xB0 | _page, true);
+	header[header_len++] = 0xB0 | _page;
+	header[header_len++] = OLED_CONTROL_BYTE_DATA_STREAM;
 
+	// The command link lives in the device, nothing is allocated per write
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(dev->_xfer, sizeof(dev->_xfer));
+	i2c_master_start(cmd);
+	i2c_master_write_byte(cmd, (dev->_address << 1) | I2C_MASTER_WRITE, true);
+	i2c_master_write(cmd, header, header_len, true);
+	i2c_master_write(cmd, images, width, true);
 	i2c_master_stop(cmd);
+	ssd1306_bus_account(dev, header_len + width, SSD1306_I2C_WIRE_NS(header_len + width));
+
 	esp_err_t res = i2c_master_cmd_begin(dev->_i2c_num, cmd, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK) {
 		ESP_LOGE(TAG, "Image command failed. code: 0x%.2X", res);
 	}
-	i2c_cmd_link_delete(cmd);
+	i2c_cmd_link_delete_static(cmd);
+}
+
+// Stream a rectangle of frame in Horizontal Addressing Mode.
+// The column/page range window makes the panel wrap by itself, so the whole
+// rectangle is a single transaction.
+void i2c_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width) {
+	if (page < 0 || seg < 0) return;
+	if (page + pages > dev->_pages) pages = dev->_pages - page;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (pages <= 0 || width <= 0) return;
 
-	cmd = i2c_cmd_link_create();
+	int _seg = seg + dev->_offsetx;
+	int _page = page;
+	if (dev->_flip) {
+		_page = dev->_pages - (page + pages);
+	}
+
+	uint8_t commands[8] = {
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_HORI_ADDR_MODE,	// 20 00
+		OLED_CMD_SET_COLUMN_RANGE, _seg, _seg + width - 1,			// 21
+		OLED_CMD_SET_PAGE_RANGE, _page, _page + pages - 1,			// 22
+	};
+	uint8_t header[17];
+	int header_len = 0;
+	for (int i = dev->_horizontal ? 2 : 0; i < sizeof(commands); i++) {
+		header[header_len++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		header[header_len++] = commands[i];
+	}
+	header[header_len++] = OLED_CONTROL_BYTE_DATA_STREAM;
+	dev->_horizontal = true;
+
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(dev->_xfer, sizeof(dev->_xfer));
 	i2c_master_start(cmd);
 	i2c_master_write_byte(cmd, (dev->_address << 1) | I2C_MASTER_WRITE, true);
-	i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_DATA_STREAM, true);
-	i2c_master_write(cmd, images, width, true);
+	i2c_master_write(cmd, header, header_len, true);
+	for (int i = 0; i < pages; i++) {
+		// Panel pages run the other way when flipped
+		int src = dev->_flip ? page + pages - 1 - i : page + i;
+		i2c_master_write(cmd, &frame[src]._segs[seg], width, true);
+	}
 	i2c_master_stop(cmd);
+	int bytes = header_len + pages * width;
+	ssd1306_bus_account(dev, bytes, SSD1306_I2C_WIRE_NS(bytes));
 
-	res = i2c_master_cmd_begin(dev->_i2c_num, cmd, I2C_TICKS_TO_WAIT);
+	esp_err_t res = i2c_master_cmd_begin(dev->_i2c_num, cmd, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK) {
 		ESP_LOGE(TAG, "Image command failed. code: 0x%.2X", res);
 	}
-	i2c_cmd_link_delete(cmd);
+	i2c_cmd_link_delete_static(cmd);
+}
+
+// Send a prepared transfer (control byte first) as one transaction, for
+// callers that build their own SSD1306 stream such as a u8g2 byte callback
+esp_err_t i2c_transmit(SSD1306_t * dev, const uint8_t * buf, size_t len) {
+	ssd1306_bus_account(dev, len, SSD1306_I2C_WIRE_NS(len));
+	esp_err_t res = i2c_master_write_to_device(dev->_i2c_num, dev->_address, buf, len, I2C_TICKS_TO_WAIT);
+	if (res != ESP_OK)
+		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
+	return res;
 }
 
 void i2c_contrast(SSD1306_t * dev, int contrast) {
@@ -199,6 +268,7 @@ void i2c_contrast(SSD1306_t * dev, int contrast) {
 	i2c_master_write_byte(cmd, OLED_CMD_SET_CONTRAST, true); // 81
 	i2c_master_write_byte(cmd, _contrast, true);
 	i2c_master_stop(cmd);
+	ssd1306_bus_account(dev, 3, SSD1306_I2C_WIRE_NS(3));
 
 	esp_err_t res = i2c_master_cmd_begin(dev->_i2c_num, cmd, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK) {
@@ -248,11 +318,7 @@ void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
 
 		i2c_master_write_byte(cmd, OLED_CMD_VERTICAL, true); // A3
 		i2c_master_write_byte(cmd, 0x00, true);
-		if (dev->_height == 64)
-		//i2c_master_write_byte(cmd, 0x7F, true);
-		i2c_master_write_byte(cmd, 0x40, true);
-		if (dev->_height == 32)
-		i2c_master_write_byte(cmd, 0x20, true);
+		i2c_master_write_byte(cmd, dev->_height, true);
 		i2c_master_write_byte(cmd, OLED_CMD_ACTIVE_SCROLL, true); // 2F
 	}
 
@@ -267,11 +333,7 @@ void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
 
 		i2c_master_write_byte(cmd, OLED_CMD_VERTICAL, true); // A3
 		i2c_master_write_byte(cmd, 0x00, true);
-		if (dev->_height == 64)
-		//i2c_master_write_byte(cmd, 0x7F, true);
-		i2c_master_write_byte(cmd, 0x40, true);
-		if (dev->_height == 32)
-		i2c_master_write_byte(cmd, 0x20, true);
+		i2c_master_write_byte(cmd, dev->_height, true);
 		i2c_master_write_byte(cmd, OLED_CMD_ACTIVE_SCROLL, true); // 2F
 	}
 
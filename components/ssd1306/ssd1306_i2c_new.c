@@ -18,7 +18,7 @@
 #define I2C_NUM I2C_NUM_0 // if spi is selected
 #endif
 
-#define I2C_MASTER_FREQ_HZ 400000 // I2C clock of SSD1306 can run at 400 kHz max.
+#define I2C_MASTER_FREQ_HZ SSD1306_I2C_FREQ_HZ
 #define I2C_TICKS_TO_WAIT 100	  // Maximum ticks to wait before issuing a timeout.
 
 void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset)
@@ -54,6 +54,7 @@ void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset)
 
 	dev->_address = I2C_ADDRESS;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_i2c_num = I2C_NUM;
 	dev->_i2c_bus_handle = i2c_bus_handle;
 	dev->_i2c_dev_handle = i2c_dev_handle;
@@ -95,6 +96,7 @@ void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t
 
 	dev->_address = i2c_address;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_i2c_num = i2c_num;
 	dev->_i2c_dev_handle = i2c_dev_handle;
 }
@@ -102,16 +104,15 @@ void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t
 void i2c_init(SSD1306_t * dev, int width, int height) {
 	dev->_width = width;
 	dev->_height = height;
-	dev->_pages = 8;
-	if (dev->_height == 32) dev->_pages = 4;
+	dev->_pages = (height + 7) / 8;
+	dev->_horizontal = false;
 	
 	uint8_t out_buf[27];
 	int out_index = 0;
 	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
 	out_buf[out_index++] = OLED_CMD_DISPLAY_OFF;				// AE
 	out_buf[out_index++] = OLED_CMD_SET_MUX_RATIO;			 // A8
-	if (dev->_height == 64) out_buf[out_index++] = 0x3F;
-	if (dev->_height == 32) out_buf[out_index++] = 0x1F;
+	out_buf[out_index++] = dev->_height - 1;
 	out_buf[out_index++] = OLED_CMD_SET_DISPLAY_OFFSET;		 // D3
 	out_buf[out_index++] = 0x00;
 	//out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;	// 40
@@ -126,8 +127,8 @@ void i2c_init(SSD1306_t * dev, int width, int height) {
 	out_buf[out_index++] = OLED_CMD_SET_DISPLAY_CLK_DIV;		// D5
 	out_buf[out_index++] = 0x80;
 	out_buf[out_index++] = OLED_CMD_SET_COM_PIN_MAP;			// DA
-	if (dev->_height == 64) out_buf[out_index++] = 0x12;
-	if (dev->_height == 32) out_buf[out_index++] = 0x02;
+	// Sequential COM pins only on 32 row panels
+	out_buf[out_index++] = (dev->_height == 32) ? 0x02 : 0x12;
 	out_buf[out_index++] = OLED_CMD_SET_CONTRAST;			// 81
 	out_buf[out_index++] = 0xFF;
 	out_buf[out_index++] = OLED_CMD_DISPLAY_RAM;				// A4
@@ -147,6 +148,7 @@ void i2c_init(SSD1306_t * dev, int width, int height) {
 	out_buf[out_index++] = OLED_CMD_DISPLAY_ON;				// AF
 
 	esp_err_t res;
+	ssd1306_bus_account(dev, out_index, SSD1306_I2C_WIRE_NS(out_index));
 	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index, I2C_TICKS_TO_WAIT);
 	if (res == ESP_OK) {
 		ESP_LOGI(TAG, "OLED configured successfully");
@@ -160,7 +162,7 @@ void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 	if (page >= dev->_pages) return;
 	if (seg >= dev->_width) return;
 
-	int _seg = seg + CONFIG_OFFSETX;
+	int _seg = seg + dev->_offsetx;
 	uint8_t columLow = _seg & 0x0F;
 	uint8_t columHigh = (_seg >> 4) & 0x0F;
 
@@ -169,33 +171,109 @@ void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 		_page = (dev->_pages - page) - 1;
 	}
 
-	uint8_t *out_buf;
-	out_buf = malloc(width < 4 ? 4 : width + 1);
-	if (out_buf == NULL) {
-		ESP_LOGE(TAG, "malloc fail");
-		return;
-	}
+	// Every command byte gets its own control byte (Co=1), so the data stream
+	// can follow in the same transaction: one START/address phase per write.
+	uint8_t *out_buf = dev->_xfer;
 	int out_index = 0;
-	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
+	if (dev->_horizontal) {
+		// Back from a burst
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = OLED_CMD_SET_MEMORY_ADDR_MODE;	// 20
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = OLED_CMD_SET_PAGE_ADDR_MODE;		// 02
+		dev->_horizontal = false;
+	}
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Lower Column Start Address for Page Addressing Mode
 	out_buf[out_index++] = (0x00 + columLow);
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Higher Column Start Address for Page Addressing Mode
 	out_buf[out_index++] = (0x10 + columHigh);
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
 	// Set Page Start Address for Page Addressing Mode
 	out_buf[out_index++] = 0xB0 | _page;
+	out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;
 
 	esp_err_t res;
-	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index, I2C_TICKS_TO_WAIT);
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+	i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+		{ .write_buffer = out_buf, .buffer_size = out_index },
+		{ .write_buffer = (uint8_t *)images, .buffer_size = width },
+	};
+	ssd1306_bus_account(dev, out_index + width, SSD1306_I2C_WIRE_NS(out_index + width));
+	res = i2c_master_multi_buffer_transmit(dev->_i2c_dev_handle, buffers, 2, I2C_TICKS_TO_WAIT);
+#else
+	if (out_index + width > SSD1306_XFER_SIZE) width = SSD1306_XFER_SIZE - out_index;
+	memcpy(&out_buf[out_index], images, width);
+	ssd1306_bus_account(dev, out_index + width, SSD1306_I2C_WIRE_NS(out_index + width));
+	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index + width, I2C_TICKS_TO_WAIT);
+#endif
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
+}
+
+// Stream a rectangle of frame in Horizontal Addressing Mode.
+// The column/page range window makes the panel wrap by itself, so the whole
+// rectangle is a single transaction.
+void i2c_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width) {
+	if (page < 0 || seg < 0) return;
+	if (page + pages > dev->_pages) pages = dev->_pages - page;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (pages <= 0 || width <= 0) return;
+
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+	int _seg = seg + dev->_offsetx;
+	int _page = page;
+	if (dev->_flip) {
+		_page = dev->_pages - (page + pages);
+	}
 
-	out_buf[0] = OLED_CONTROL_BYTE_DATA_STREAM;
-	memcpy(&out_buf[1], images, width);
+	uint8_t commands[8] = {
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_HORI_ADDR_MODE,	// 20 00
+		OLED_CMD_SET_COLUMN_RANGE, _seg, _seg + width - 1,			// 21
+		OLED_CMD_SET_PAGE_RANGE, _page, _page + pages - 1,			// 22
+	};
+	uint8_t *out_buf = dev->_xfer;
+	int out_index = 0;
+	for (int i = dev->_horizontal ? 2 : 0; i < sizeof(commands); i++) {
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = commands[i];
+	}
+	out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;
+	dev->_horizontal = true;
+
+	i2c_master_transmit_multi_buffer_info_t buffers[1 + 8];
+	int count = 0;
+	buffers[count].write_buffer = out_buf;
+	buffers[count++].buffer_size = out_index;
+	for (int i = 0; i < pages; i++) {
+		// Panel pages run the other way when flipped
+		int src = dev->_flip ? page + pages - 1 - i : page + i;
+		buffers[count].write_buffer = (uint8_t *)&frame[src]._segs[seg];
+		buffers[count++].buffer_size = width;
+	}
+
+	int bytes = out_index + pages * width;
+	ssd1306_bus_account(dev, bytes, SSD1306_I2C_WIRE_NS(bytes));
+	esp_err_t res = i2c_master_multi_buffer_transmit(dev->_i2c_dev_handle, buffers, count, I2C_TICKS_TO_WAIT);
+	if (res != ESP_OK)
+		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
+#else
+	// No multi-buffer transmit, fall back to one write per page
+	for (int _page = page; _page < page + pages; _page++) {
+		i2c_display_image(dev, _page, seg, &frame[_page]._segs[seg], width);
+	}
+#endif
+}
 
-	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, width + 1, I2C_TICKS_TO_WAIT);
+// Send a prepared transfer (control byte first) as one transaction, for
+// callers that build their own SSD1306 stream such as a u8g2 byte callback
+esp_err_t i2c_transmit(SSD1306_t * dev, const uint8_t * buf, size_t len) {
+	ssd1306_bus_account(dev, len, SSD1306_I2C_WIRE_NS(len));
+	esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, buf, len, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
-	free(out_buf);
+	return res;
 }
 
 void i2c_contrast(SSD1306_t * dev, int contrast) {
@@ -209,6 +287,7 @@ void i2c_contrast(SSD1306_t * dev, int contrast) {
 	out_buf[out_index++] = OLED_CMD_SET_CONTRAST; // 81
 	out_buf[out_index++] = _contrast;
 
+	ssd1306_bus_account(dev, 3, SSD1306_I2C_WIRE_NS(3));
 	esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, 3, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
@@ -253,11 +332,7 @@ void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
 
 		out_buf[out_index++] = OLED_CMD_VERTICAL; // A3
 		out_buf[out_index++] = 0x00;
-		if (dev->_height == 64)
-		//out_buf[out_index++] = 0x7F;
-		out_buf[out_index++] = 0x40;
-		if (dev->_height == 32)
-		out_buf[out_index++] = 0x20;
+		out_buf[out_index++] = dev->_height;
 		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
 	}
 
@@ -272,11 +347,7 @@ void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
 
 		out_buf[out_index++] = OLED_CMD_VERTICAL; // A3
 		out_buf[out_index++] = 0x00;
-		if (dev->_height == 64)
-		//out_buf[out_index++] = 0x7F;
-		out_buf[out_index++] = 0x40;
-		if (dev->_height == 32)
-		out_buf[out_index++] = 0x20;
+		out_buf[out_index++] = dev->_height;
 		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
 	}
 
@@ -284,6 +355,7 @@ void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
 		out_buf[out_index++] = OLED_CMD_DEACTIVE_SCROLL; // 2E
 	}
 
+	ssd1306_bus_account(dev, out_index, SSD1306_I2C_WIRE_NS(out_index));
 	esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
@@ -4,6 +4,7 @@
 #include "freertos/task.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 
 #include "ssd1306.h"
@@ -79,7 +80,9 @@ void spi_master_init(SSD1306_t * dev, int16_t mosi, int16_t sclk, int16_t cs, in
 	dev->_dc = dc;
 	dev->_address = SPI_ADDRESS;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_spi_device_handle = spi_device_handle;
+	dev->_dma_buf = NULL;
 }
 
 void spi_device_add(SSD1306_t * dev, int16_t cs, int16_t dc, int16_t reset)
@@ -135,7 +138,9 @@ void spi_device_add(SSD1306_t * dev, int16_t cs, int16_t dc, int16_t reset)
 	dev->_dc = dc;
 	dev->_address = SPI_ADDRESS;
 	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
 	dev->_spi_device_handle = spi_device_handle;
+	dev->_dma_buf = NULL;
 }
 
 
@@ -155,6 +160,7 @@ bool spi_master_write_byte(const spi_device_handle_t SPIHandle, const uint8_t* D
 
 bool spi_master_write_commands(SSD1306_t * dev, const uint8_t * Commands, size_t DataLength )
 {
+	ssd1306_bus_account(dev, DataLength, SSD1306_SPI_WIRE_NS(DataLength, clock_speed_hz));
 	gpio_set_level( dev->_dc, SPI_COMMAND_MODE );
 	return spi_master_write_byte( dev->_spi_device_handle, Commands, DataLength );
 }
@@ -168,6 +174,7 @@ bool spi_master_write_command(SSD1306_t * dev, uint8_t Command )
 
 bool spi_master_write_data(SSD1306_t * dev, const uint8_t* Data, size_t DataLength )
 {
+	ssd1306_bus_account(dev, DataLength, SSD1306_SPI_WIRE_NS(DataLength, clock_speed_hz));
 	gpio_set_level( dev->_dc, SPI_DATA_MODE );
 	return spi_master_write_byte( dev->_spi_device_handle, Data, DataLength );
 }
@@ -177,13 +184,12 @@ void spi_init(SSD1306_t * dev, int width, int height)
 {
 	dev->_width = width;
 	dev->_height = height;
-	dev->_pages = 8;
-	if (dev->_height == 32) dev->_pages = 4;
+	dev->_pages = (height + 7) / 8;
+	dev->_horizontal = false;
 
 	spi_master_write_command(dev, OLED_CMD_DISPLAY_OFF);			// AE
 	spi_master_write_command(dev, OLED_CMD_SET_MUX_RATIO);			// A8
-	if (dev->_height == 64) spi_master_write_command(dev, 0x3F);
-	if (dev->_height == 32) spi_master_write_command(dev, 0x1F);
+	spi_master_write_command(dev, dev->_height - 1);
 	spi_master_write_command(dev, OLED_CMD_SET_DISPLAY_OFFSET);		// D3
 	spi_master_write_command(dev, 0x00);
 	spi_master_write_command(dev, OLED_CONTROL_BYTE_DATA_STREAM);	// 40
@@ -197,8 +203,8 @@ void spi_init(SSD1306_t * dev, int width, int height)
 	spi_master_write_command(dev, OLED_CMD_SET_DISPLAY_CLK_DIV);	// D5
 	spi_master_write_command(dev, 0x80);
 	spi_master_write_command(dev, OLED_CMD_SET_COM_PIN_MAP);		// DA
-	if (dev->_height == 64) spi_master_write_command(dev, 0x12);
-	if (dev->_height == 32) spi_master_write_command(dev, 0x02);
+	// Sequential COM pins only on 32 row panels
+	spi_master_write_command(dev, (dev->_height == 32) ? 0x02 : 0x12);
 	spi_master_write_command(dev, OLED_CMD_SET_CONTRAST);			// 81
 	spi_master_write_command(dev, 0xFF);
 	spi_master_write_command(dev, OLED_CMD_DISPLAY_RAM);			// A4
@@ -224,7 +230,7 @@ void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 	if (page >= dev->_pages) return;
 	if (seg >= dev->_width) return;
 
-	int _seg = seg + CONFIG_OFFSETX;
+	int _seg = seg + dev->_offsetx;
 	uint8_t columLow = _seg & 0x0F;
 	uint8_t columHigh = (_seg >> 4) & 0x0F;
 
@@ -233,6 +239,13 @@ void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 		_page = (dev->_pages - page) - 1;
 	}
 
+	if (dev->_horizontal) {
+		// Back from a burst
+		uint8_t commands[2] = { OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_PAGE_ADDR_MODE };
+		spi_master_write_commands(dev, commands, 2);
+		dev->_horizontal = false;
+	}
+
 	// Set Lower Column Start Address for Page Addressing Mode, Higher Column Start Address for Page Addressing Mode and Page Start Address for Page Addressing Mode
 	uint8_t commands[3] = { 0x00 + columLow, 0x10 + columHigh, 0xB0 | _page };
 	spi_master_write_commands(dev, commands, 3);
@@ -241,6 +254,58 @@ void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 
 }
 
+// Stream a rectangle of frame in Horizontal Addressing Mode
+// as one queued DMA transfer.
+void spi_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width)
+{
+	if (page < 0 || seg < 0) return;
+	if (page + pages > dev->_pages) pages = dev->_pages - page;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (pages <= 0 || width <= 0) return;
+
+	// Allocated once, the pages of frame are not contiguous
+	if (dev->_dma_buf == NULL) {
+		dev->_dma_buf = heap_caps_malloc(dev->_pages * dev->_width, MALLOC_CAP_DMA);
+		if (dev->_dma_buf == NULL) {
+			ESP_LOGE(TAG, "heap_caps_malloc fail");
+			return;
+		}
+	}
+
+	int _seg = seg + dev->_offsetx;
+	int _page = page;
+	if (dev->_flip) {
+		_page = dev->_pages - (page + pages);
+	}
+
+	uint8_t commands[8] = {
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_HORI_ADDR_MODE,	// 20 00
+		OLED_CMD_SET_COLUMN_RANGE, _seg, _seg + width - 1,			// 21
+		OLED_CMD_SET_PAGE_RANGE, _page, _page + pages - 1,			// 22
+	};
+	int skip = dev->_horizontal ? 2 : 0;
+	spi_master_write_commands(dev, &commands[skip], sizeof(commands) - skip);
+	dev->_horizontal = true;
+
+	int length = 0;
+	for (int i = 0; i < pages; i++) {
+		// Panel pages run the other way when flipped
+		int src = dev->_flip ? page + pages - 1 - i : page + i;
+		memcpy(&dev->_dma_buf[length], &frame[src]._segs[seg], width);
+		length = length + width;
+	}
+
+	ssd1306_bus_account(dev, length, SSD1306_SPI_WIRE_NS(length, clock_speed_hz));
+	gpio_set_level( dev->_dc, SPI_DATA_MODE );
+	spi_transaction_t SPITransaction;
+	memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
+	SPITransaction.length = length * 8;
+	SPITransaction.tx_buffer = dev->_dma_buf;
+	spi_transaction_t * result;
+	spi_device_queue_trans( dev->_spi_device_handle, &SPITransaction, portMAX_DELAY );
+	spi_device_get_trans_result( dev->_spi_device_handle, &result, portMAX_DELAY );
+}
+
 void spi_contrast(SSD1306_t * dev, int contrast) {
 	int _contrast = contrast;
 	if (contrast < 0x0) _contrast = 0;
@@ -286,10 +351,7 @@ void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
 
 		spi_master_write_command(dev, OLED_CMD_VERTICAL);			// A3
 		spi_master_write_command(dev, 0x00);
-		if (dev->_height == 64)
-			spi_master_write_command(dev, 0x40);
-		if (dev->_height == 32)
-			spi_master_write_command(dev, 0x20);
+		spi_master_write_command(dev, dev->_height);
 		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
 	}
 
@@ -304,10 +366,7 @@ void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
 
 		spi_master_write_command(dev, OLED_CMD_VERTICAL);			// A3
 		spi_master_write_command(dev, 0x00);
-		if (dev->_height == 64)
-			spi_master_write_command(dev, 0x40);
-		if (dev->_height == 32)
-			spi_master_write_command(dev, 0x20);
+		spi_master_write_command(dev, dev->_height);
 		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
 	}
 
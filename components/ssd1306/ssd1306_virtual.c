@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+
+#include "ssd1306.h"
+
+#define TAG "SSD1306"
+
+// In-memory panel for host builds. The transport entry points build the same
+// byte streams as the i2c driver and a decoder plays them into a copy of the
+// controller's GDDRAM, so what ends up on the "glass" and what it cost on the
+// bus can both be checked without a board.
+
+#define VPANEL_COLUMNS 128
+#define VPANEL_PAGES 8
+
+struct ssd1306_virtual {
+	uint8_t _ram[VPANEL_PAGES][VPANEL_COLUMNS]; // GDDRAM
+	int _mode; // Memory addressing mode (20h), page mode after reset
+	int _col;
+	int _page;
+	int _colStart; // Window of the horizontal/vertical modes
+	int _colEnd;
+	int _pageStart;
+	int _pageEnd;
+	uint8_t _cmd[8]; // Command being assembled from the stream
+	int _cmdLen;
+	int _cmdNeed;
+	bool _expectControl; // Next byte of the transaction is a control byte
+	bool _data; // D/C# of the last control byte
+	bool _single; // Co of the last control byte
+	int _contrast;
+	int _startLine;
+	bool _on;
+	bool _allOn;
+	bool _inverted;
+	bool _segRemap; // A1
+	bool _comRemap; // C8
+	bool _scrolling;
+	ssd1306_virtual_stats_t _stats;
+};
+
+static void vpanel_reset(ssd1306_virtual_t * v)
+{
+	memset(v, 0, sizeof(*v));
+	v->_mode = OLED_CMD_SET_PAGE_ADDR_MODE;
+	v->_colEnd = VPANEL_COLUMNS - 1;
+	v->_pageEnd = VPANEL_PAGES - 1;
+	v->_contrast = 0x7F;
+}
+
+// Number of parameter bytes following a command
+static int vpanel_args(uint8_t cmd)
+{
+	switch (cmd) {
+	case OLED_CMD_SET_CONTRAST:
+	case OLED_CMD_SET_MEMORY_ADDR_MODE:
+	case OLED_CMD_SET_MUX_RATIO:
+	case OLED_CMD_SET_DISPLAY_OFFSET:
+	case OLED_CMD_SET_DISPLAY_CLK_DIV:
+	case OLED_CMD_SET_PRECHARGE:
+	case OLED_CMD_SET_COM_PIN_MAP:
+	case OLED_CMD_SET_VCOMH_DESELCT:
+	case OLED_CMD_SET_CHARGE_PUMP:
+	case 0xAD: // Internal IREF (SSD1306B), sent by u8g2 for the 72x40 panel
+		return 1;
+	case OLED_CMD_SET_COLUMN_RANGE:
+	case OLED_CMD_SET_PAGE_RANGE:
+	case OLED_CMD_VERTICAL:
+		return 2;
+	case OLED_CMD_CONTINUOUS_SCROLL:
+	case 0x2A: // Vertical and left horizontal scroll
+		return 5;
+	case OLED_CMD_HORIZONTAL_RIGHT:
+	case OLED_CMD_HORIZONTAL_LEFT:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+static void vpanel_command(ssd1306_virtual_t * v, const uint8_t * cmd)
+{
+	uint8_t c = cmd[0];
+	v->_stats.commands++;
+	if (c <= 0x0F) {
+		v->_col = (v->_col & 0xF0) | (c & 0x0F);
+	} else if (c >= 0x10 && c <= 0x1F) {
+		v->_col = ((c & 0x0F) << 4) | (v->_col & 0x0F);
+		v->_col &= VPANEL_COLUMNS - 1;
+	} else if (c >= 0x40 && c <= 0x7F) {
+		v->_startLine = c & 0x3F;
+	} else if (c >= 0xB0 && c <= 0xB7) {
+		v->_page = c & 0x07;
+	} else {
+		switch (c) {
+		case OLED_CMD_SET_MEMORY_ADDR_MODE:
+			if ((cmd[1] & 0x03) != 0x03) v->_mode = cmd[1] & 0x03;
+			break;
+		case OLED_CMD_SET_COLUMN_RANGE:
+			v->_colStart = cmd[1] & (VPANEL_COLUMNS - 1);
+			v->_colEnd = cmd[2] & (VPANEL_COLUMNS - 1);
+			v->_col = v->_colStart;
+			break;
+		case OLED_CMD_SET_PAGE_RANGE:
+			v->_pageStart = cmd[1] & (VPANEL_PAGES - 1);
+			v->_pageEnd = cmd[2] & (VPANEL_PAGES - 1);
+			v->_page = v->_pageStart;
+			break;
+		case OLED_CMD_SET_CONTRAST:
+			v->_contrast = cmd[1];
+			break;
+		case OLED_CMD_SET_SEGMENT_REMAP_0:
+		case OLED_CMD_SET_SEGMENT_REMAP_1:
+			v->_segRemap = (c == OLED_CMD_SET_SEGMENT_REMAP_1);
+			break;
+		case 0xC0:
+		case OLED_CMD_SET_COM_SCAN_MODE:
+			v->_comRemap = (c == OLED_CMD_SET_COM_SCAN_MODE);
+			break;
+		case OLED_CMD_DISPLAY_RAM:
+		case OLED_CMD_DISPLAY_ALLON:
+			v->_allOn = (c == OLED_CMD_DISPLAY_ALLON);
+			break;
+		case OLED_CMD_DISPLAY_NORMAL:
+		case OLED_CMD_DISPLAY_INVERTED:
+			v->_inverted = (c == OLED_CMD_DISPLAY_INVERTED);
+			break;
+		case OLED_CMD_DISPLAY_OFF:
+		case OLED_CMD_DISPLAY_ON:
+			v->_on = (c == OLED_CMD_DISPLAY_ON);
+			break;
+		case OLED_CMD_DEACTIVE_SCROLL:
+		case OLED_CMD_ACTIVE_SCROLL:
+			v->_scrolling = (c == OLED_CMD_ACTIVE_SCROLL);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void vpanel_command_byte(ssd1306_virtual_t * v, uint8_t b)
+{
+	if (v->_cmdLen == 0) v->_cmdNeed = 1 + vpanel_args(b);
+	v->_cmd[v->_cmdLen++] = b;
+	if (v->_cmdLen < v->_cmdNeed) return;
+	vpanel_command(v, v->_cmd);
+	v->_cmdLen = 0;
+}
+
+// GDDRAM write and pointer advance of the current addressing mode
+static void vpanel_data_byte(ssd1306_virtual_t * v, uint8_t b)
+{
+	v->_ram[v->_page][v->_col] = b;
+	v->_stats.data++;
+	if (v->_mode == OLED_CMD_SET_HORI_ADDR_MODE) {
+		if (v->_col == v->_colEnd) {
+			v->_col = v->_colStart;
+			v->_page = (v->_page == v->_pageEnd) ? v->_pageStart : v->_page + 1;
+		} else {
+			v->_col = (v->_col + 1) & (VPANEL_COLUMNS - 1);
+		}
+	} else if (v->_mode == OLED_CMD_SET_VERT_ADDR_MODE) {
+		if (v->_page == v->_pageEnd) {
+			v->_page = v->_pageStart;
+			v->_col = (v->_col == v->_colEnd) ? v->_colStart : v->_col + 1;
+		} else {
+			v->_page = (v->_page + 1) & (VPANEL_PAGES - 1);
+		}
+	} else {
+		v->_col = (v->_col + 1) & (VPANEL_COLUMNS - 1);
+	}
+}
+
+// A transaction may arrive in several pieces, as it would from a multi-buffer
+// transmit: vpanel_begin, vpanel_feed for every piece, then nothing to close
+static void vpanel_begin(ssd1306_virtual_t * v)
+{
+	v->_stats.transactions++;
+	v->_expectControl = true;
+}
+
+static void vpanel_feed(ssd1306_virtual_t * v, const uint8_t * buf, size_t len)
+{
+	v->_stats.bytes += len;
+	for (size_t i = 0; i < len; i++) {
+		if (v->_expectControl) {
+			v->_data = (buf[i] & OLED_CONTROL_BYTE_DATA_STREAM) != 0;
+			v->_single = (buf[i] & OLED_CONTROL_BYTE_CMD_SINGLE) != 0;
+			v->_expectControl = false;
+			continue;
+		}
+		if (v->_data) {
+			vpanel_data_byte(v, buf[i]);
+		} else {
+			vpanel_command_byte(v, buf[i]);
+		}
+		// Co=1: one byte, then another control byte
+		if (v->_single) v->_expectControl = true;
+	}
+}
+
+static void vpanel_send(SSD1306_t * dev, const uint8_t * buf, size_t len)
+{
+	if (dev->_virtual == NULL) return;
+	ssd1306_bus_account(dev, len, SSD1306_I2C_WIRE_NS(len));
+	vpanel_begin(dev->_virtual);
+	vpanel_feed(dev->_virtual, buf, len);
+}
+
+static void vpanel_attach(SSD1306_t * dev, int address)
+{
+	if (dev->_virtual == NULL) dev->_virtual = malloc(sizeof(ssd1306_virtual_t));
+	if (dev->_virtual == NULL) {
+		ESP_LOGE(TAG, "Virtual panel allocation failed");
+		return;
+	}
+	vpanel_reset(dev->_virtual);
+	dev->_address = address;
+	dev->_flip = false;
+	dev->_offsetx = CONFIG_OFFSETX;
+	dev->_i2c_num = 0;
+}
+
+void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset)
+{
+	ESP_LOGI(TAG, "Virtual panel is used");
+	vpanel_attach(dev, I2C_ADDRESS);
+}
+
+void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address)
+{
+	ESP_LOGI(TAG, "Virtual panel is used");
+	vpanel_attach(dev, i2c_address);
+	dev->_i2c_num = i2c_num;
+}
+
+void i2c_init(SSD1306_t * dev, int width, int height) {
+	dev->_width = width;
+	dev->_height = height;
+	dev->_pages = (height + 7) / 8;
+	dev->_horizontal = false;
+
+	uint8_t out_buf[] = {
+		OLED_CONTROL_BYTE_CMD_STREAM,
+		OLED_CMD_DISPLAY_OFF,
+		OLED_CMD_SET_MUX_RATIO, dev->_height - 1,
+		OLED_CMD_SET_DISPLAY_OFFSET, 0x00,
+		OLED_CMD_SET_DISPLAY_START_LINE,
+		dev->_flip ? OLED_CMD_SET_SEGMENT_REMAP_0 : OLED_CMD_SET_SEGMENT_REMAP_1,
+		OLED_CMD_SET_COM_SCAN_MODE,
+		OLED_CMD_SET_DISPLAY_CLK_DIV, 0x80,
+		OLED_CMD_SET_COM_PIN_MAP, (dev->_height == 32) ? 0x02 : 0x12,
+		OLED_CMD_SET_CONTRAST, 0xFF,
+		OLED_CMD_DISPLAY_RAM,
+		OLED_CMD_SET_VCOMH_DESELCT, 0x40,
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_PAGE_ADDR_MODE,
+		0x00, 0x10,
+		OLED_CMD_SET_CHARGE_PUMP, 0x14,
+		OLED_CMD_DEACTIVE_SCROLL,
+		OLED_CMD_DISPLAY_NORMAL,
+		OLED_CMD_DISPLAY_ON,
+	};
+	vpanel_send(dev, out_buf, sizeof(out_buf));
+}
+
+void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width) {
+	if (page >= dev->_pages) return;
+	if (seg >= dev->_width) return;
+	if (dev->_virtual == NULL) return;
+
+	int _seg = seg + dev->_offsetx;
+	int _page = page;
+	if (dev->_flip) {
+		_page = (dev->_pages - page) - 1;
+	}
+
+	uint8_t *out_buf = dev->_xfer;
+	int out_index = 0;
+	if (dev->_horizontal) {
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = OLED_CMD_SET_MEMORY_ADDR_MODE;
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = OLED_CMD_SET_PAGE_ADDR_MODE;
+		dev->_horizontal = false;
+	}
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+	out_buf[out_index++] = 0x00 + (_seg & 0x0F);
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+	out_buf[out_index++] = 0x10 + ((_seg >> 4) & 0x0F);
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+	out_buf[out_index++] = 0xB0 | _page;
+	out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;
+
+	ssd1306_bus_account(dev, out_index + width, SSD1306_I2C_WIRE_NS(out_index + width));
+	vpanel_begin(dev->_virtual);
+	vpanel_feed(dev->_virtual, out_buf, out_index);
+	vpanel_feed(dev->_virtual, images, width);
+}
+
+// Same stream as the multi-buffer path of the i2c driver: one transaction for
+// the whole rectangle in Horizontal Addressing Mode
+void i2c_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width) {
+	if (page < 0 || seg < 0) return;
+	if (page + pages > dev->_pages) pages = dev->_pages - page;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+	if (pages <= 0 || width <= 0) return;
+	if (dev->_virtual == NULL) return;
+
+	int _seg = seg + dev->_offsetx;
+	int _page = page;
+	if (dev->_flip) {
+		_page = dev->_pages - (page + pages);
+	}
+
+	uint8_t commands[8] = {
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_HORI_ADDR_MODE,
+		OLED_CMD_SET_COLUMN_RANGE, _seg, _seg + width - 1,
+		OLED_CMD_SET_PAGE_RANGE, _page, _page + pages - 1,
+	};
+	uint8_t *out_buf = dev->_xfer;
+	int out_index = 0;
+	for (int i = dev->_horizontal ? 2 : 0; i < sizeof(commands); i++) {
+		out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+		out_buf[out_index++] = commands[i];
+	}
+	out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;
+	dev->_horizontal = true;
+
+	int bytes = out_index + pages * width;
+	ssd1306_bus_account(dev, bytes, SSD1306_I2C_WIRE_NS(bytes));
+	vpanel_begin(dev->_virtual);
+	vpanel_feed(dev->_virtual, out_buf, out_index);
+	for (int i = 0; i < pages; i++) {
+		int src = dev->_flip ? page + pages - 1 - i : page + i;
+		vpanel_feed(dev->_virtual, &frame[src]._segs[seg], width);
+	}
+}
+
+esp_err_t i2c_transmit(SSD1306_t * dev, const uint8_t * buf, size_t len) {
+	if (dev->_virtual == NULL) return ESP_ERR_INVALID_STATE;
+	vpanel_send(dev, buf, len);
+	return ESP_OK;
+}
+
+void i2c_contrast(SSD1306_t * dev, int contrast) {
+	uint8_t _contrast = contrast;
+	if (contrast < 0x0) _contrast = 0;
+	if (contrast > 0xFF) _contrast = 0xFF;
+
+	uint8_t out_buf[] = { OLED_CONTROL_BYTE_CMD_STREAM, OLED_CMD_SET_CONTRAST, _contrast };
+	vpanel_send(dev, out_buf, sizeof(out_buf));
+}
+
+// The scroll is only recorded, the panel RAM does not move
+void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
+	uint8_t out_buf[11];
+	int out_index = 0;
+	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
+
+	if (scroll == SCROLL_RIGHT || scroll == SCROLL_LEFT) {
+		out_buf[out_index++] = (scroll == SCROLL_RIGHT) ? OLED_CMD_HORIZONTAL_RIGHT : OLED_CMD_HORIZONTAL_LEFT;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = 0x07;
+		out_buf[out_index++] = 0x07;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = 0xFF;
+		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL;
+	}
+
+	if (scroll == SCROLL_DOWN || scroll == SCROLL_UP) {
+		out_buf[out_index++] = OLED_CMD_CONTINUOUS_SCROLL;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = 0x07;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = (scroll == SCROLL_DOWN) ? 0x3F : 0x01;
+		out_buf[out_index++] = OLED_CMD_VERTICAL;
+		out_buf[out_index++] = 0x00;
+		out_buf[out_index++] = dev->_height;
+		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL;
+	}
+
+	if (scroll == SCROLL_STOP) {
+		out_buf[out_index++] = OLED_CMD_DEACTIVE_SCROLL;
+	}
+
+	vpanel_send(dev, out_buf, out_index);
+}
+
+// SPI configurations render into the same panel
+void spi_master_init(SSD1306_t * dev, int16_t mosi, int16_t sclk, int16_t cs, int16_t dc, int16_t reset)
+{
+	ESP_LOGI(TAG, "Virtual panel is used");
+	vpanel_attach(dev, SPI_ADDRESS);
+}
+
+void spi_device_add(SSD1306_t * dev, int16_t cs, int16_t dc, int16_t reset)
+{
+	spi_master_init(dev, -1, -1, cs, dc, reset);
+}
+
+void spi_init(SSD1306_t * dev, int width, int height)
+{
+	i2c_init(dev, width, height);
+}
+
+void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width)
+{
+	i2c_display_image(dev, page, seg, images, width);
+}
+
+void spi_display_rect(SSD1306_t * dev, const PAGE_t * frame, int page, int seg, int pages, int width)
+{
+	i2c_display_rect(dev, frame, page, seg, pages, width);
+}
+
+void spi_contrast(SSD1306_t * dev, int contrast)
+{
+	i2c_contrast(dev, contrast);
+}
+
+void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
+{
+	i2c_hardware_scroll(dev, scroll);
+}
+
+// Pixel (x, y) of the visible window as the glass shows it, taking segment
+// remap, COM scan direction, start line, inversion and display on/off into
+// account. A1/C8 is the upright orientation ssd1306_init sets up.
+bool ssd1306_virtual_pixel(SSD1306_t * dev, int x, int y)
+{
+	ssd1306_virtual_t * v = dev->_virtual;
+	if (v == NULL) return false;
+	if (x < 0 || x >= dev->_width || y < 0 || y >= dev->_height) return false;
+	if (v->_on == false) return false;
+	if (v->_allOn) return true;
+
+	int col = v->_segRemap ? dev->_offsetx + x : dev->_offsetx + dev->_width - 1 - x;
+	int row = v->_comRemap ? y : dev->_height - 1 - y;
+	row = (row + v->_startLine) % (VPANEL_PAGES * 8);
+	bool on = (v->_ram[row / 8][col & (VPANEL_COLUMNS - 1)] >> (row % 8)) & 1;
+	return on != v->_inverted;
+}
+
+// Write the visible window as a binary PBM (P4), 1 = lit
+bool ssd1306_virtual_dump_pbm(SSD1306_t * dev, const char * path)
+{
+	if (dev->_virtual == NULL) return false;
+	FILE * fp = fopen(path, "wb");
+	if (fp == NULL) {
+		ESP_LOGE(TAG, "Could not open %s", path);
+		return false;
+	}
+	fprintf(fp, "P4\n%d %d\n", dev->_width, dev->_height);
+	for (int y = 0; y < dev->_height; y++) {
+		uint8_t row[SSD1306_MAX_WIDTH / 8] = {0};
+		for (int x = 0; x < dev->_width; x++) {
+			if (ssd1306_virtual_pixel(dev, x, y)) row[x / 8] |= 0x80 >> (x % 8);
+		}
+		fwrite(row, 1, (dev->_width + 7) / 8, fp);
+	}
+	fclose(fp);
+	return true;
+}
+
+// The controller's GDDRAM, VPANEL_PAGES rows of 128 columns
+const uint8_t * ssd1306_virtual_ram(SSD1306_t * dev)
+{
+	if (dev->_virtual == NULL) return NULL;
+	return &dev->_virtual->_ram[0][0];
+}
+
+int ssd1306_virtual_contrast(SSD1306_t * dev)
+{
+	if (dev->_virtual == NULL) return -1;
+	return dev->_virtual->_contrast;
+}
+
+// Bus cost since the last call, e.g. per rendered frame
+ssd1306_virtual_stats_t ssd1306_virtual_take_stats(SSD1306_t * dev)
+{
+	ssd1306_virtual_stats_t stats = {0};
+	if (dev->_virtual == NULL) return stats;
+	stats = dev->_virtual->_stats;
+	memset(&dev->_virtual->_stats, 0, sizeof(stats));
+	ESP_LOGD(TAG, "transactions=%"PRIu32" bytes=%"PRIu32" data=%"PRIu32" commands=%"PRIu32,
+		stats.transactions, stats.bytes, stats.data, stats.commands);
+	return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd1306.h"
+
+// Display bus budgets: the most bytes (after the I2C address) an operation
+// may send. The host tests (test/host/test_bus_budget.c) run every budgeted
+// operation against the virtual panel and fail on overrun, so a change that
+// doubles the traffic fails the build's tests. On a bench device
+// CONFIG_UI_BUS_BUDGET_CHECK compares the ssd1306 transport counters against
+// the same budgets per frame and aborts.
+
+// A frame row is one 8 pixel high page: addressing commands and control
+// bytes (u8g2 sends 24 data bytes per transfer) plus one byte per column
+#define BUS_ROW_OVERHEAD 16
+#define BUS_BUDGET_ROWS(rows, width) ((rows) * ((width) + BUS_ROW_OVERHEAD))
+
+// ssd1306 driver operations: a line of text is one page row (the text is
+// clipped to the panel width), the fadeout one frame per pixel row that each
+// changes a single page row
+#define BUS_BUDGET_TEXT_LINE(width) BUS_BUDGET_ROWS(1, width)
+#define BUS_BUDGET_FADEOUT(pages, width) BUS_BUDGET_ROWS((pages) * 8, width)
+
+typedef struct
+{
+    const char *name;
+    uint32_t max_bytes;
+} bus_budget_t;
+
+static inline void bus_budget_check(const bus_budget_t *budget, ssd1306_bus_stats_t stats)
+{
+    if (stats.bytes <= budget->max_bytes)
+        return;
+    printf("Bus budget exceeded: %s sent %lu bytes in %lu transactions (%llu us on the wire), budget %lu\n",
+           budget->name, (unsigned long)stats.bytes, (unsigned long)stats.transactions,
+           (unsigned long long)(stats.wire_ns / 1000), (unsigned long)budget->max_bytes);
+    abort();
+}
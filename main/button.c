@@ -0,0 +1,163 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/queue.h"
+#include "button.h"
+
+static const char *TAG = "button";
+
+// The pin interrupt only starts the debounce timer, everything else runs in
+// esp_timer callbacks (one task, so they never race each other). Nothing
+// polls: between presses the CPU is not woken at all. The interrupt is level
+// triggered on the level the pin is not at, which is also what a GPIO light
+// sleep wake-up needs, and a change during the debounce is never missed.
+#define BUTTON_DEBOUNCE_MS 30
+#define BUTTON_LONG_PRESS_MS 800     // held at least this long
+#define BUTTON_DOUBLE_CLICK_MS 300   // second click within this after the first release
+#define BUTTON_QUEUE_LEN 8
+
+static gpio_num_t button_gpio;
+static TaskHandle_t button_notify_task;
+static uint32_t button_notify_bits;
+static QueueHandle_t button_queue;
+static button_action_t button_actions[BUTTON_EVENT_COUNT];
+
+static esp_timer_handle_t debounce_timer;
+static esp_timer_handle_t long_timer;
+static esp_timer_handle_t click_timer;
+
+// esp_timer task only
+static bool pressed;          // debounced state
+static bool long_sent;        // this press already reported as long
+static bool click_pending;    // released once, waiting for a second click
+
+static void button_post(button_event_t event)
+{
+    if (xQueueSend(button_queue, &event, 0) != pdTRUE)
+        ESP_LOGW(TAG, "event queue full, dropped %d", event);
+    if (button_notify_task != NULL)
+        xTaskNotify(button_notify_task, button_notify_bits, eSetBits);
+}
+
+// Wait for the pin to leave the debounced level
+static void button_arm(bool now_pressed)
+{
+    gpio_int_type_t level = now_pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+    gpio_set_intr_type(button_gpio, level);
+    gpio_wakeup_enable(button_gpio, level);
+    gpio_intr_enable(button_gpio);
+}
+
+static void IRAM_ATTR button_isr(void *arg)
+{
+    // Quiet the pin until the contacts settle
+    gpio_intr_disable(button_gpio);
+    esp_timer_start_once(debounce_timer, BUTTON_DEBOUNCE_MS * 1000);
+}
+
+static void debounce_cb(void *arg)
+{
+    bool now_pressed = (gpio_get_level(button_gpio) == 0);
+    button_arm(now_pressed);
+
+    if (now_pressed == pressed)
+        return; // bounce
+    pressed = now_pressed;
+
+    if (pressed)
+    {
+        long_sent = false;
+        esp_timer_start_once(long_timer, BUTTON_LONG_PRESS_MS * 1000);
+        return;
+    }
+
+    esp_timer_stop(long_timer);
+    if (long_sent)
+        return;
+    if (click_pending)
+    {
+        esp_timer_stop(click_timer);
+        click_pending = false;
+        button_post(BUTTON_DOUBLE_CLICK);
+    }
+    else
+    {
+        click_pending = true;
+        esp_timer_start_once(click_timer, BUTTON_DOUBLE_CLICK_MS * 1000);
+    }
+}
+
+static void long_cb(void *arg)
+{
+    if (!pressed)
+        return;
+    long_sent = true;
+    // A click before a long press is not a double click
+    if (click_pending)
+    {
+        esp_timer_stop(click_timer);
+        click_pending = false;
+        button_post(BUTTON_SHORT_PRESS);
+    }
+    button_post(BUTTON_LONG_PRESS);
+}
+
+static void click_cb(void *arg)
+{
+    if (!click_pending)
+        return;
+    click_pending = false;
+    button_post(BUTTON_SHORT_PRESS);
+}
+
+esp_err_t button_init(gpio_num_t gpio, TaskHandle_t notify_task, uint32_t notify_bits)
+{
+    button_gpio = gpio;
+    button_notify_task = notify_task;
+    button_notify_bits = notify_bits;
+    button_queue = xQueueCreate(BUTTON_QUEUE_LEN, sizeof(button_event_t));
+    if (button_queue == NULL)
+        return ESP_ERR_NO_MEM;
+
+    const esp_timer_create_args_t debounce_args = {.callback = debounce_cb, .name = "btn_debounce"};
+    const esp_timer_create_args_t long_args = {.callback = long_cb, .name = "btn_long"};
+    const esp_timer_create_args_t click_args = {.callback = click_cb, .name = "btn_click"};
+    ESP_ERROR_CHECK(esp_timer_create(&debounce_args, &debounce_timer));
+    ESP_ERROR_CHECK(esp_timer_create(&long_args, &long_timer));
+    ESP_ERROR_CHECK(esp_timer_create(&click_args, &click_timer));
+
+    gpio_config_t btn_conf = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_LOW_LEVEL, // released, see button_arm
+    };
+    esp_err_t err = gpio_config(&btn_conf);
+    if (err != ESP_OK)
+        return err;
+    err = gpio_wakeup_enable(gpio, GPIO_INTR_LOW_LEVEL);
+    if (err != ESP_OK)
+        return err;
+
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) // already installed is fine
+        return err;
+    return gpio_isr_handler_add(gpio, button_isr, NULL);
+}
+
+void button_set_action(button_event_t event, button_action_t action)
+{
+    if (event < BUTTON_EVENT_COUNT)
+        button_actions[event] = action;
+}
+
+bool button_get_event(button_event_t *event)
+{
+    return xQueueReceive(button_queue, event, 0) == pdTRUE;
+}
+
+void button_run_action(button_event_t event)
+{
+    if (event < BUTTON_EVENT_COUNT && button_actions[event] != NULL)
+        button_actions[event]();
+}
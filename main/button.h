@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef enum {
+    BUTTON_SHORT_PRESS,
+    BUTTON_LONG_PRESS,
+    BUTTON_DOUBLE_CLICK,
+    BUTTON_EVENT_COUNT,
+} button_event_t;
+
+typedef void (*button_action_t)(void);
+
+// Active-low button with the internal pull-up. Gestures are queued and
+// notify_task gets notify_bits (eSetBits) for every one of them.
+esp_err_t button_init(gpio_num_t gpio, TaskHandle_t notify_task, uint32_t notify_bits);
+void button_set_action(button_event_t event, button_action_t action); // NULL to ignore the gesture
+bool button_get_event(button_event_t *event); // next queued gesture, never blocks
+void button_run_action(button_event_t event);
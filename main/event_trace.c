@@ -0,0 +1,64 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "event_trace.h"
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "TRACE_EVENTS must be a power of two");
+_Static_assert(TRACE_ID_COUNT <= UINT8_MAX, "trace ids are stored in a byte");
+
+static const char *const trace_names[TRACE_ID_COUNT] = {
+#define TRACE_NAME(id, name, track) name,
+    TRACE_LIST(TRACE_NAME)
+#undef TRACE_NAME
+};
+
+static const char *const trace_tracks[TRACE_ID_COUNT] = {
+#define TRACE_TRACK(id, name, track) track,
+    TRACE_LIST(TRACE_TRACK)
+#undef TRACE_TRACK
+};
+
+static trace_event_t trace_ring[TRACE_EVENTS];
+static uint32_t trace_head; // events recorded since boot
+static volatile bool trace_paused;
+
+// Any task, no lock: concurrent writers get different slots. A writer that is
+// preempted between taking its slot and filling it may leave one stale event
+// in a dump.
+void trace_record(trace_id_t id, uint8_t phase, uint16_t arg)
+{
+    if (trace_paused)
+        return;
+    uint32_t slot = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (TRACE_EVENTS - 1);
+    trace_event_t *e = &trace_ring[slot];
+    e->time_us = (uint32_t)esp_timer_get_time();
+    e->id = id;
+    e->phase = phase;
+    e->arg = arg;
+}
+
+// Text, one event per line, so a serial monitor log can be fed to the host
+// tool as is:
+//   TRACE BEGIN <now_us> <events>
+//   TRACE N <id> <name> <track>
+//   TRACE E <time_us> <id> <phase> <arg>
+//   TRACE END
+// Recording is paused while printing.
+void trace_dump(void)
+{
+    trace_paused = true;
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+    uint32_t count = head < TRACE_EVENTS ? head : TRACE_EVENTS;
+
+    printf("TRACE BEGIN %" PRIu32 " %" PRIu32 "\n", (uint32_t)esp_timer_get_time(), count);
+    for (int id = 0; id < TRACE_ID_COUNT; id++)
+        printf("TRACE N %d %s %s\n", id, trace_names[id], trace_tracks[id]);
+    for (uint32_t i = head - count; i != head; i++)
+    {
+        const trace_event_t *e = &trace_ring[i & (TRACE_EVENTS - 1)];
+        printf("TRACE E %" PRIu32 " %u %c %u\n", e->time_us, e->id, e->phase, e->arg);
+    }
+    printf("TRACE END\n");
+    trace_paused = false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Timestamped begin/end/instant events in a RAM ring, TRACE_EVENTS of them,
+// oldest overwritten first. Recording an event is one atomic add and an
+// 8 byte store, cheap enough to leave on. trace_dump() prints the ring for
+// tools/trace_to_chrome.py.
+//   X(id, name, track) - events of one track are drawn on one timeline row
+#define TRACE_LIST(X)                                         \
+    X(TRACE_SENSOR_READ,     "sensor.read",     "sensor")     \
+    X(TRACE_SENSOR_TRIGGER,  "sensor.trigger",  "sensor")     \
+    X(TRACE_SENSOR_FETCH,    "sensor.fetch",    "sensor")     \
+    X(TRACE_FSM_UPDATE,      "fsm.update",      "fsm")        \
+    X(TRACE_FSM_TRANSITION,  "fsm.transition",  "fsm")        \
+    X(TRACE_NVS_COMMIT,      "nvs.commit",      "nvs")        \
+    X(TRACE_UI_RENDER,       "ui.render",       "ui")         \
+    X(TRACE_UI_FLUSH,        "ui.flush",        "ui.flush")   \
+    X(TRACE_WIFI_CONNECTED,  "wifi.connected",  "wifi")       \
+    X(TRACE_WIFI_GOT_IP,     "wifi.got_ip",     "wifi")       \
+    X(TRACE_SNTP_WAIT,       "sntp.wait",       "wifi")       \
+    X(TRACE_SNTP_SYNCED,     "sntp.synced",     "wifi")       \
+    X(TRACE_LOOP_JITTER,     "loop.jitter",     "sensor")
+
+typedef enum {
+#define TRACE_ENUM(id, name, track) id,
+    TRACE_LIST(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_ID_COUNT,
+} trace_id_t;
+
+#define TRACE_EVENTS 512 // power of two, 4 KB
+
+// Same letters as the Chrome trace "ph" field
+#define TRACE_PHASE_BEGIN   'B'
+#define TRACE_PHASE_END     'E'
+#define TRACE_PHASE_INSTANT 'i'
+
+typedef struct
+{
+    uint32_t time_us; // low 32 bits of esp_timer_get_time, wraps every 71 min
+    uint8_t id;
+    uint8_t phase;
+    uint16_t arg;
+} trace_event_t;
+
+#if CONFIG_EVENT_TRACE
+void trace_record(trace_id_t id, uint8_t phase, uint16_t arg);
+void trace_dump(void);
+
+#define TRACE_BEGIN(id) trace_record((id), TRACE_PHASE_BEGIN, 0)
+#define TRACE_END(id) trace_record((id), TRACE_PHASE_END, 0)
+#define TRACE_INSTANT(id, arg) trace_record((id), TRACE_PHASE_INSTANT, (arg))
+#else
+#define TRACE_BEGIN(id) ((void)0)
+#define TRACE_END(id) ((void)0)
+#define TRACE_INSTANT(id, arg) ((void)(arg))
+static inline void trace_dump(void) {}
+#endif
@@ -7,6 +7,8 @@
 #include "nvs.h"
 #include <time.h>
 #include "time_sync_wifi.h"
+#include "metrics.h"
+#include "event_trace.h"
 
 #define FAN_ON 0
 #define FAN_OFF 1
@@ -21,6 +23,7 @@ static int64_t last_high_humidity_time = 0;
 static int64_t fan_start_time = 0;
 static int64_t last_transition_time = 0;
 static bool fan_on = false;
+static fsm_clock_t fsm_clock = esp_timer_get_time; // time base of every FSM timer
 static const uint8_t image_clock_quarters_bits[] = {0xe0, 0x03, 0x98, 0x0c, 0x84, 0x10, 0x02, 0x20, 0x82, 0x20, 0x81, 0x40, 0x81, 0x40, 0x87, 0x70, 0x01, 0x41, 0x01, 0x42, 0x02, 0x20, 0x02, 0x20, 0x84, 0x10, 0x98, 0x0c, 0xe0, 0x03, 0x00, 0x00};
 static const uint8_t image_device_power_button_bits[] = {0x80, 0x00, 0x80, 0x00, 0x98, 0x0c, 0xa4, 0x12, 0x92, 0x24, 0x8a, 0x28, 0x85, 0x50, 0x05, 0x50, 0x05, 0x50, 0x05, 0x50, 0x05, 0x50, 0x0a, 0x28, 0x12, 0x24, 0xe4, 0x13, 0x18, 0x0c, 0xe0, 0x03};
 static const uint8_t image_file_upload_bits[] = {0x00, 0x00, 0x80, 0x00, 0xc0, 0x01, 0xe0, 0x03, 0x90, 0x04, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x87, 0x70, 0x05, 0x50, 0xfd, 0x5f, 0x01, 0x40, 0x01, 0x40, 0xff, 0x7f, 0x00, 0x00, 0x00, 0x00};
@@ -31,7 +34,7 @@ static const uint8_t image_moon_white_bits[] = {0x20, 0x08, 0x38, 0x08, 0x14, 0x
 static void fsm_turn_fan_on()
 {
     fan_on = true;
-    fan_start_time = esp_timer_get_time();
+    fan_start_time = fsm_clock();
     gpio_set_level(FAN_RELAY_GPIO, FAN_ON);
 }
 
@@ -53,9 +56,47 @@ bool fsm_is_fan_on()
     return fan_on;
 }
 
+void fsm_set_clock(fsm_clock_t clock)
+{
+    fsm_clock = clock ? clock : esp_timer_get_time;
+}
+
+// Real-world time when synced, time since boot otherwise
+void fsm_format_log_line(char *buf, size_t len, const char *transition_label, float humidity)
+{
+    if (time_is_valid())
+    {
+        // Use real-world time
+        time_t now;
+        time(&now);
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+
+        snprintf(buf, len,
+                 "%02d:%02d:%02d: %s [%.1f%%]",
+                 timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
+                 transition_label, humidity);
+    }
+    else
+    {
+        // Fallback: time since boot
+        int seconds = fsm_clock() / 1000000;
+        int hours = seconds / 3600;
+        int minutes = (seconds % 3600) / 60;
+        int secs = seconds % 60;
+
+        snprintf(buf, len,
+                 "+%02d:%02d:%02d: %s [%.1f%%]",
+                 hours, minutes, secs,
+                 transition_label, humidity);
+    }
+}
+
 static void log_fsm_transition_to_nvs(const char *transition_label, float humidity)
 {
-    int64_t now_us = esp_timer_get_time();
+    TRACE_INSTANT(TRACE_FSM_TRANSITION, current_state);
+
+    int64_t now_us = fsm_clock();
     int seconds = now_us / 1000000;
 
     static bool initialized_logged = false;
@@ -80,37 +121,18 @@ static void log_fsm_transition_to_nvs(const char *transition_label, float humidi
     snprintf(key, sizeof(key), "entry_%lu", (unsigned long)index);
 
     char log_line[64];
-
-    if (time_is_valid())
-    {
-        // Use real-world time
-        time_t now;
-        time(&now);
-        struct tm timeinfo;
-        localtime_r(&now, &timeinfo);
-
-        snprintf(log_line, sizeof(log_line),
-                 "%02d:%02d:%02d: %s [%.1f%%]",
-                 timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
-                 transition_label, humidity);
-    }
-    else
-    {
-        // Fallback: time since boot
-        int hours = seconds / 3600;
-        int minutes = (seconds % 3600) / 60;
-        int secs = seconds % 60;
-
-        snprintf(log_line, sizeof(log_line),
-                 "+%02d:%02d:%02d: %s [%.1f%%]",
-                 hours, minutes, secs,
-                 transition_label, humidity);
-    }
+    fsm_format_log_line(log_line, sizeof(log_line), transition_label, humidity);
 
     // Store in NVS
+    int64_t t = metrics_start();
     nvs_set_str(handle, key, log_line);
     nvs_set_u32(handle, "log_index", index);
+    metrics_stop(METRIC_NVS_WRITE_US, t);
+    t = metrics_start();
+    TRACE_BEGIN(TRACE_NVS_COMMIT);
     nvs_commit(handle);
+    TRACE_END(TRACE_NVS_COMMIT);
+    metrics_stop(METRIC_NVS_COMMIT_US, t);
     nvs_close(handle);
 }
 
@@ -118,7 +140,7 @@ void fsm_init()
 {
     current_state = IDLE;
     fsm_turn_fan_off();
-    last_high_humidity_time = esp_timer_get_time();
+    last_high_humidity_time = fsm_clock();
     fan_start_time = 0;
     last_transition_time = 0;
     esp_err_t err = nvs_flash_init();
@@ -149,7 +171,7 @@ void fsm_init()
 
 void fsm_update(float humidity)
 {
-    int64_t now = esp_timer_get_time();
+    int64_t now = fsm_clock();
 
     switch (current_state)
     {
@@ -209,7 +231,7 @@ void fsm_update(float humidity)
 
 void fsm_get_display_lines(char *fan_line, char *timer_line, char *state_line)
 {
-    int64_t now = esp_timer_get_time();
+    int64_t now = fsm_clock();
 
     strcpy(fan_line, fan_on ? "FAN ON " : "FAN OFF");
 
@@ -272,13 +294,14 @@ uint8_t *fsm_get_state_icon()
 
 void fsm_set_manual_override(bool new_state)
 {
-    int64_t now = esp_timer_get_time();
+    int64_t now = fsm_clock();
 
     if (new_state)
     {
         current_state = COOLING;
         fsm_turn_fan_on();
         LOGI("Manual override: FAN ON (COOLING)\n");
+        TRACE_INSTANT(TRACE_FSM_TRANSITION, current_state);
     }
     else
     {
@@ -286,5 +309,6 @@ void fsm_set_manual_override(bool new_state)
         fsm_turn_fan_off();
         last_high_humidity_time = now;
         LOGI("Manual override: FAN OFF (IDLE)\n");
+        TRACE_INSTANT(TRACE_FSM_TRANSITION, current_state);
     }
 }
@@ -3,6 +3,7 @@
 #define FSM_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "ssd1306.h"
 
@@ -28,6 +29,12 @@ bool fsm_is_fan_on(void);
 void fsm_get_display_lines(char *fan_line, char *timer_line, char *state_line);
 void fsm_set_manual_override(bool fan_state);
 uint8_t *fsm_get_state_icon(void);
+void fsm_format_log_line(char *buf, size_t len, const char *transition_label, float humidity);
+
+// Microseconds since boot. Replacing the clock lets the 30 min / 2 h / 6 h
+// timers be driven off-device; NULL restores esp_timer_get_time.
+typedef int64_t (*fsm_clock_t)(void);
+void fsm_set_clock(fsm_clock_t clock);
 
 
 #endif
\ No newline at end of file
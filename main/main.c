@@ -2,8 +2,10 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
 #include "aht.h"
 #include "ssd1306.h"
 #include "esp_mac.h"
@@ -11,34 +13,143 @@
 #include "fsm.h"
 #include "u8g2.h"
 #include "u8x8.h"
-#include "u8g2_esp32_hal.h"
+#include "u8g2_ssd1306_hal.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "time_sync_wifi.h"
+#include "button.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "telemetry.h"
+#include "event_trace.h"
+#include "microbench.h"
+#include "bus_budget.h"
+#include "power.h"
+#include "ui_screens.h"
 
 // ----- Display setup -----
 u8g2_t u8g2;
-
-#define DISPLAY_OFFSET_X 28
-#define DISPLAY_OFFSET_Y 24
-#define OFFSET_X(x) ((x) + DISPLAY_OFFSET_X)
-#define OFFSET_Y(y) ((y) + DISPLAY_OFFSET_Y)
+static SSD1306_t oled; // i2c transport for u8g2
 
 #define UI_PAGE_STATUS 0
 #define UI_PAGE_LOGS   1
 #define UI_PAGE_COUNT  2
-#define UI_SCREEN_INTERVAL_TICKS 15  // 15 seconds
-#define LOG_SCROLL_INTERVAL_TICKS 1  // scroll logs every second
-#define MAX_LOG_LINES 4
-#define MAX_LOG_ENTRIES 50
+#define UI_PAGE_INTERVAL_MS 3000     // status screen and the first two log pages
+#define LOG_SCROLL_INTERVAL_MS 1000  // further log pages
 
 static int log_total_pages = 1;
 static int log_page_index = 0;
 
 static int ui_screen_index = 0;
 
+// ----- UI task -----
+// The UI runs on its own clock: it redraws when the frame deadline passes
+// (the status timer counts seconds) or as soon as an event arrives, and turns
+// pages on its own schedule. The sensor loop only posts the latest sample, so
+// a failing read neither freezes the screen nor waits for rendering.
+#define UI_TASK_PRIORITY 2
+#define UI_FRAME_PERIOD_MS 1000
+
+#define UI_EVENT_SAMPLE (1 << 0) // new temperature/humidity reading
+#define UI_EVENT_STATE  (1 << 1) // FSM state or fan changed
+#define UI_EVENT_BUTTON (1 << 2) // gestures waiting in the button queue
+
+typedef struct
+{
+    float temp;
+    float hum;
+} ui_sample_t;
+
+static QueueHandle_t ui_sample_queue; // length 1, always the latest sample
+static TaskHandle_t ui_task_handle;
+static TickType_t ui_page_deadline; // UI task only
+static bool ui_pages_started;
+
+// ----- Frame buffer -----
+// CONFIG_UI_BUFFER_FULL keeps the whole frame in RAM (three more copies for
+// the flush task). The page-buffer modes keep one or two 8-pixel rows and
+// draw every screen once per row in a u8g2_FirstPage/u8g2_NextPage loop,
+// sending each row from the UI task as it is finished.
+#if CONFIG_UI_BUFFER_PAGE_1
+#define UI_U8G2_SETUP u8g2_Setup_ssd1306_i2c_72x40_er_1
+#define UI_BUFFER_MODE_NAME "1 page"
+#elif CONFIG_UI_BUFFER_PAGE_2
+#define UI_U8G2_SETUP u8g2_Setup_ssd1306_i2c_72x40_er_2
+#define UI_BUFFER_MODE_NAME "2 pages"
+#else
+#define UI_U8G2_SETUP u8g2_Setup_ssd1306_i2c_72x40_er_f
+#define UI_BUFFER_MODE_NAME "full"
+#endif
+
+// Draws one screen into the u8g2 buffer, may run once per page
+typedef void (*ui_render_fn)(const void *ctx);
+
+#if CONFIG_UI_RENDER_BENCHMARK
+// Averages over UI_BENCH_FRAMES presented frames: render is the time spent in
+// the draw calls (all passes), frame the whole ui_present including the bus
+// in page mode
+#define UI_BENCH_FRAMES 32
+static int64_t bench_render_us;
+static int64_t bench_frame_us;
+static int bench_frames;
+#endif
+
+static char last_status_key[64]; // inputs of the status screen currently on the panel
+
+// ----- Bus budgets -----
+// Checked per frame with CONFIG_UI_BUS_BUDGET_CHECK and by the host tests,
+// see bus_budget.h
+static const bus_budget_t ui_budget_status = {"status page refresh", UI_FRAME_BUDGET_BYTES};
+static const bus_budget_t ui_budget_log = {"log page refresh", UI_FRAME_BUDGET_BYTES};
+static const bus_budget_t ui_budget_loading = {"loading screen", UI_FRAME_BUDGET_BYTES};
+
+#if CONFIG_UI_BUFFER_FULL
+// ----- Frame flush -----
+// Drawing never waits for the bus: ui_send_buffer copies the finished u8g2
+// frame to a front buffer and a low-priority task sends it, so rendering the
+// next frame overlaps with the transfer. A newer frame replaces one that is
+// still waiting. Only the tiles (8x8 px) that differ from what the panel shows
+// are sent, usually just the mm:ss timer. With CONFIG_UI_SKIP_UNCHANGED_FRAMES
+// the status screen is not even redrawn when none of its inputs changed.
+#define UI_FLUSH_TASK_PRIORITY 1
+#define FRAME_SIZE (DISPLAY_WIDTH * DISPLAY_HEIGHT / 8)
+
+static uint8_t front_frames[2][FRAME_SIZE];
+static uint8_t *pending_frame = front_frames[0]; // swapped in, not sent yet
+static uint8_t *sending_frame = front_frames[1]; // owned by the flush task
+static bool pending_valid = false;
+static const bus_budget_t *pending_budget; // of pending_frame
+static SemaphoreHandle_t frame_mutex;
+static TaskHandle_t flush_task_handle;
+
+static uint8_t last_frame[FRAME_SIZE]; // what the panel shows, flush task only
+static bool last_frame_valid = false;
+#endif
+
+// ----- Display power -----
+// Nobody looks at the panel most of the time: after UI_DIM_AFTER_S without a
+// button press or state change it is dimmed, after UI_OFF_AFTER_S it is put
+// into power save and nothing is drawn or sent until the next wake-up. The
+// task that owns the bus (the flush task, or the UI task in page-buffer mode)
+// applies the changes before its next frame.
+#define UI_DIM_AFTER_S 30
+#define UI_OFF_AFTER_S 120
+#define UI_CONTRAST_FULL 255
+#define UI_CONTRAST_DIM 16
+
+typedef enum
+{
+    UI_POWER_ON,
+    UI_POWER_DIM,
+    UI_POWER_OFF,
+} ui_power_t;
+
+static volatile ui_power_t ui_power_wanted = UI_POWER_ON;
+static ui_power_t ui_power_applied = UI_POWER_ON; // bus owner only
+static volatile TickType_t ui_last_activity;
+
 // ----- I2C Setup -----
-#define I2C_MASTER_PORT I2C_NUM_0
+// The ssd1306 component owns the bus, u8g2 and the AHT10 both go through it
 #define I2C_MASTER_SDA GPIO_NUM_5
 #define I2C_MASTER_SCL GPIO_NUM_6
 
@@ -48,164 +159,381 @@ static int ui_screen_index = 0;
 
 #define RELAY_ON 0
 #define RELAY_OFF 1
-#define DEBOUNCE_DELAY_MS 50
+
+// ----- Sensor loop -----
+#define SENSOR_PERIOD_MS 1000
+// Print the metrics registry every so often, 0 to only read it on demand
+#define METRICS_REPORT_INTERVAL_S 300
+// Print the event trace when the loop runs this late, at most once per
+// TRACE_DUMP_MIN_INTERVAL_S
+#define TRACE_DUMP_JITTER_US 100000
+#define TRACE_DUMP_MIN_INTERVAL_S 600
+
+// Gesture -> action (see the ui_action_* functions), NULL to ignore
+#define BUTTON_SHORT_ACTION  ui_action_toggle_fan
+#define BUTTON_LONG_ACTION   ui_action_next_screen
+#define BUTTON_DOUBLE_ACTION ui_action_status_screen
 
 volatile bool relay_state = false;
 
-void my_i2c_master_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl)
+// Bus owner only: the panel keeps its RAM in power save, so waking up needs
+// no redraw
+static void ui_power_sync(void)
 {
-    u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
-    u8g2_esp32_hal.bus.i2c.sda = I2C_MASTER_SDA;
-    u8g2_esp32_hal.bus.i2c.scl = I2C_MASTER_SCL;
-    u8g2_esp32_hal_init(u8g2_esp32_hal);
+    ui_power_t to = ui_power_wanted;
+    ui_power_t from = ui_power_applied;
+    if (to == from)
+        return;
+    ui_power_applied = to;
+    if (to == UI_POWER_OFF)
+    {
+        u8g2_SetPowerSave(&u8g2, 1);
+        return;
+    }
+    u8g2_SetContrast(&u8g2, to == UI_POWER_DIM ? UI_CONTRAST_DIM : UI_CONTRAST_FULL);
+    if (from == UI_POWER_OFF)
+        u8g2_SetPowerSave(&u8g2, 0);
 }
 
-void check_button_task(void *arg)
-{
-    bool last_state = true; // Button is is in the HIGH (through pull-up)
-    TickType_t last_debounce_time = 0;
+#if CONFIG_UI_BUFFER_FULL
 
+static void ui_flush_task(void *arg)
+{
     while (1)
     {
-        bool current_state = gpio_get_level(BUTTON_GPIO);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-        if (current_state != last_state)
+        ui_power_sync();
+        // A frame handed over while off stays pending for the wake-up
+        if (ui_power_applied == UI_POWER_OFF)
+            continue;
+
+        xSemaphoreTake(frame_mutex, portMAX_DELAY);
+        bool pending = pending_valid;
+        const bus_budget_t *budget = pending_budget;
+        if (pending)
         {
-            last_debounce_time = xTaskGetTickCount();
-            last_state = current_state;
+            uint8_t *tmp = sending_frame;
+            sending_frame = pending_frame;
+            pending_frame = tmp;
+            pending_valid = false;
         }
+        xSemaphoreGive(frame_mutex);
+
+        if (!pending)
+            continue;
+#if CONFIG_UI_BUS_BUDGET_CHECK
+        ssd1306_take_bus_stats(&oled); // power changes are not part of the frame
+#endif
+
+        int64_t flush_start = metrics_start();
+        TRACE_BEGIN(TRACE_UI_FLUSH);
+        ui_send_changed_tiles(&u8g2, sending_frame, last_frame, last_frame_valid);
+        last_frame_valid = true;
+        TRACE_END(TRACE_UI_FLUSH);
+        metrics_stop(METRIC_UI_FLUSH_US, flush_start);
+#if CONFIG_UI_BUS_BUDGET_CHECK
+        bus_budget_check(budget, ssd1306_take_bus_stats(&oled));
+#else
+        (void)budget;
+#endif
+    }
+}
 
-        if (!current_state && // pressed (LOW)
-            (xTaskGetTickCount() - last_debounce_time) > pdMS_TO_TICKS(DEBOUNCE_DELAY_MS))
-        {
-            // Wait for the button release
-            while (gpio_get_level(BUTTON_GPIO) == 0)
-            {
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
+static void ui_flush_init(void)
+{
+    frame_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(ui_flush_task, "ui_flush_task", 3072, NULL, UI_FLUSH_TASK_PRIORITY, &flush_task_handle);
+}
 
-            // Click handler
-            relay_state = !fsm_is_fan_on();
-            fsm_set_manual_override(relay_state);
-            printf("Relay toggled: %s\n", fsm_is_fan_on() ? "ON" : "OFF");
-        }
+// Hand the u8g2 buffer to the flush task, never waits for the bus
+static void ui_send_buffer(const bus_budget_t *budget)
+{
+    xSemaphoreTake(frame_mutex, portMAX_DELAY);
+    memcpy(pending_frame, u8g2_GetBufferPtr(&u8g2), FRAME_SIZE);
+    pending_budget = budget;
+    pending_valid = true;
+    xSemaphoreGive(frame_mutex);
+    xTaskNotifyGive(flush_task_handle);
+}
+#endif
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+// Draw a screen and get it to the panel within budget
+static void ui_present(ui_render_fn render, const void *ctx, const bus_budget_t *budget)
+{
+    int64_t frame_start = metrics_start();
+    int64_t render_us = 0;
+#if CONFIG_UI_BUFFER_FULL
+    TRACE_BEGIN(TRACE_UI_RENDER);
+    u8g2_ClearBuffer(&u8g2);
+    render(ctx);
+    TRACE_END(TRACE_UI_RENDER);
+    render_us = esp_timer_get_time() - frame_start;
+    ui_send_buffer(budget); // the flush task records ui.flush_us
+#else
+    // Rendering and sending alternate per page, the whole loop is one flush
+#if CONFIG_UI_BUS_BUDGET_CHECK
+    ssd1306_take_bus_stats(&oled);
+#endif
+    TRACE_BEGIN(TRACE_UI_FLUSH);
+    u8g2_FirstPage(&u8g2);
+    do
+    {
+        int64_t pass_start = esp_timer_get_time();
+        TRACE_BEGIN(TRACE_UI_RENDER);
+        render(ctx);
+        TRACE_END(TRACE_UI_RENDER);
+        render_us += esp_timer_get_time() - pass_start;
+    } while (u8g2_NextPage(&u8g2));
+    TRACE_END(TRACE_UI_FLUSH);
+#if CONFIG_UI_BUS_BUDGET_CHECK
+    bus_budget_check(budget, ssd1306_take_bus_stats(&oled));
+#endif
+#endif
+#if !CONFIG_UI_BUFFER_FULL || CONFIG_UI_RENDER_BENCHMARK
+    int64_t frame_us = esp_timer_get_time() - frame_start;
+#endif
+    metrics_record(METRIC_UI_RENDER_US, render_us);
+#if !CONFIG_UI_BUFFER_FULL
+    metrics_record(METRIC_UI_FLUSH_US, frame_us - render_us);
+#endif
+    metrics_count(METRIC_UI_FRAMES, 1);
+#if CONFIG_UI_RENDER_BENCHMARK
+    bench_render_us += render_us;
+    bench_frame_us += frame_us;
+    if (++bench_frames == UI_BENCH_FRAMES)
+    {
+        printf("UI bench (%s buffer): render %lld us/frame, frame %lld us/frame\n", UI_BUFFER_MODE_NAME,
+               (long long)(bench_render_us / bench_frames), (long long)(bench_frame_us / bench_frames));
+        bench_render_us = 0;
+        bench_frame_us = 0;
+        bench_frames = 0;
     }
+#endif
+}
+
+static void ui_set_power(ui_power_t power)
+{
+    if (ui_power_wanted == power)
+        return;
+    ui_power_wanted = power;
+#if CONFIG_UI_BUFFER_FULL
+    xTaskNotifyGive(flush_task_handle);
+#endif
+    // In page-buffer mode the UI task syncs before every frame
+}
+
+// Restart the idle timeout, returns true when the panel was off
+static bool ui_wake(void)
+{
+    bool was_off = (ui_power_wanted == UI_POWER_OFF);
+    ui_last_activity = xTaskGetTickCount();
+    ui_set_power(UI_POWER_ON);
+    return was_off;
+}
+
+static void ui_power_update(void)
+{
+    TickType_t idle = xTaskGetTickCount() - ui_last_activity;
+    if (idle >= pdMS_TO_TICKS(UI_OFF_AFTER_S * 1000))
+        ui_set_power(UI_POWER_OFF);
+    else if (idle >= pdMS_TO_TICKS(UI_DIM_AFTER_S * 1000))
+        ui_set_power(UI_POWER_DIM);
+}
+
+static void render_log_screen(const void *ctx)
+{
+    ui_render_log(&u8g2, ctx);
 }
 
 static void draw_log_screen()
 {
-    u8g2_ClearBuffer(&u8g2);
-    u8g2_SetFont(&u8g2, u8g2_font_profont10_tr);
+    // Read before drawing, a page-buffer render runs several passes
+    static log_screen_t screen;
+    last_status_key[0] = '\0';
+
+    int pages = ui_load_log_screen(&screen, log_page_index);
+    if (pages >= 0)
+        log_total_pages = pages;
+    ui_present(render_log_screen, &screen, &ui_budget_log);
+}
 
-    nvs_handle_t handle;
-    if (nvs_open("fsm_log", NVS_READONLY, &handle) != ESP_OK)
-    {
-        u8g2_DrawStr(&u8g2, OFFSET_X(0), OFFSET_Y(10), "Log: NVS error");
-        u8g2_SendBuffer(&u8g2);
-        return;
-    }
+static void render_current_state(const void *ctx)
+{
+    ui_render_status(&u8g2, ctx);
+}
 
-    uint32_t index = 0;
-    nvs_get_u32(handle, "log_index", &index);
+void draw_current_state(const char *hum_line, const char *temp_line)
+{
+    char fan_line[20];
+    char timer_line[20];
+    char state_line[20];
+    fsm_get_display_lines(fan_line, timer_line, state_line);
 
-    // Calculate how many logs we actually have
-    int entries_found = 0;
-    for (int i = 0; i < MAX_LOG_ENTRIES; i++)
-    {
-        char key[16];
-        snprintf(key, sizeof(key), "entry_%d", i);
-        size_t len = 0;
-        if (nvs_get_str(handle, key, NULL, &len) == ESP_OK && len > 1)
-            entries_found++;
-    }
+    status_screen_t screen = {
+        .hum_line = hum_line,
+        .temp_line = temp_line,
+        .timer_line = timer_line,
+        .state_icon = fsm_get_state_icon(),
+        .fan_on = fsm_is_fan_on(),
+    };
 
-    log_total_pages = (entries_found + MAX_LOG_LINES - 1) / MAX_LOG_LINES;
+#if CONFIG_UI_SKIP_UNCHANGED_FRAMES
+    // Everything this screen shows, the frame is skipped when it is unchanged
+    char key[64];
+    snprintf(key, sizeof(key), "%s|%s|%s|%p|%d", hum_line, temp_line, timer_line,
+             (const void *)screen.state_icon, screen.fan_on);
+    if (strcmp(key, last_status_key) == 0)
+        return;
+    strcpy(last_status_key, key);
+#endif
 
-    // Get logs from newest to oldest
-    int start = entries_found - 1 - (log_page_index * MAX_LOG_LINES);
-    int shown = 0;
+    ui_present(render_current_state, &screen, &ui_budget_status);
+}
 
-    for (int i = start; i >= 0 && shown < MAX_LOG_LINES; i--)
-    {
-        char key[32];
-        snprintf(key, sizeof(key), "entry_%d", i);
+static void render_loading(const void *ctx)
+{
+    ui_render_loading(&u8g2);
+}
 
-        char line[64];
-        size_t len = sizeof(line);
-        if (nvs_get_str(handle, key, line, &len) == ESP_OK)
+static void ui_next_page(void)
+{
+    if (ui_screen_index == UI_PAGE_LOGS)
+    {
+        log_page_index++;
+        if (log_page_index >= log_total_pages)
         {
-            int y = OFFSET_Y(8 + shown * 8);
-            u8g2_DrawStr(&u8g2, OFFSET_X(0), y, line);
-            shown++;
+            log_page_index = 0;
+            ui_screen_index = UI_PAGE_STATUS;
         }
     }
+    else
+    {
+        ui_screen_index = UI_PAGE_LOGS;
+        log_page_index = 0;
+    }
+}
 
-    // Draw pagination info in the last line
-    char footer[32];
-    snprintf(footer, sizeof(footer), "[%d / %d]", log_page_index + 1, log_total_pages);
-    u8g2_DrawStr(&u8g2, OFFSET_X(0), OFFSET_Y(8 + MAX_LOG_LINES * 8), footer);
+static TickType_t ui_page_duration(void)
+{
+    if (ui_screen_index == UI_PAGE_LOGS && log_page_index >= 2)
+        return pdMS_TO_TICKS(LOG_SCROLL_INTERVAL_MS);
+    return pdMS_TO_TICKS(UI_PAGE_INTERVAL_MS);
+}
 
-    nvs_close(handle);
-    u8g2_SendBuffer(&u8g2);
+// Button actions, run by the UI task
+static void ui_action_toggle_fan(void)
+{
+    relay_state = !fsm_is_fan_on();
+    fsm_set_manual_override(relay_state);
+    printf("Relay toggled: %s\n", fsm_is_fan_on() ? "ON" : "OFF");
 }
 
-void draw_current_state(const char *hum_line, const char *temp_line)
+static void ui_action_next_screen(void)
 {
-    static const uint8_t image_choice_bullet_off_bits[] = {0xe0, 0x03, 0x38, 0x0e, 0x0c, 0x18, 0x06, 0x30, 0x02, 0x20, 0x03, 0x60, 0x01, 0x40, 0x01, 0x40, 0x01, 0x40, 0x03, 0x60, 0x02, 0x20, 0x06, 0x30, 0x0c, 0x18, 0x38, 0x0e, 0xe0, 0x03, 0x00, 0x00};
-    static const uint8_t image_choice_bullet_on_bits[] = {0xe0, 0x03, 0x38, 0x0e, 0xcc, 0x19, 0xf6, 0x37, 0xfa, 0x2f, 0xfb, 0x6f, 0xfd, 0x5f, 0xfd, 0x5f, 0xfd, 0x5f, 0xfb, 0x6f, 0xfa, 0x2f, 0xf6, 0x37, 0xcc, 0x19, 0x38, 0x0e, 0xe0, 0x03, 0x00, 0x00};
-    static const uint8_t image_Hum_arrow_bits[] = {0x80, 0xff, 0xff, 0x7f, 0x40, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00};
-    static const uint8_t image_Temp_arrow_bits[] = {0xff, 0xff, 0x7f};
-    static const uint8_t image_weather_humidity_white_bits[] = {0x00, 0x00, 0x04, 0x00, 0x00, 0x02, 0x00, 0x00, 0x01, 0x00, 0x80, 0x00, 0x00, 0x40, 0x00, 0x00, 0x20, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x20, 0x00, 0x00, 0x30, 0x00, 0x00, 0x50, 0x00, 0x00, 0x48, 0x00, 0x00, 0x88, 0x00, 0x00, 0x04, 0x01, 0x00, 0x04, 0x01, 0x00, 0x82, 0x02, 0x00, 0x02, 0x03, 0x00, 0x01, 0x05, 0x00, 0x01, 0x04, 0x00, 0x02, 0x02, 0x00, 0x02, 0x02, 0x00, 0x0c, 0x01, 0x00, 0xf0, 0x00, 0x00};
-    static const uint8_t image_weather_temperature_bits[] = {0x38, 0x00, 0x44, 0x40, 0xd4, 0xa0, 0x54, 0x40, 0xd4, 0x1c, 0x54, 0x06, 0xd4, 0x02, 0x54, 0x02, 0x54, 0x06, 0x92, 0x1c, 0x39, 0x01, 0x75, 0x01, 0x7d, 0x01, 0x39, 0x01, 0x82, 0x00, 0x7c, 0x00};
-    u8g2_ClearBuffer(&u8g2);
-    u8g2_SetBitmapMode(&u8g2, 1);
-    u8g2_SetFontMode(&u8g2, 1);
+    ui_next_page();
+    ui_page_deadline = xTaskGetTickCount() + ui_page_duration();
+}
 
-    // Humidity
-    u8g2_SetFont(&u8g2, u8g2_font_profont11_tr);
-    u8g2_DrawStr(&u8g2, OFFSET_X(19), OFFSET_Y(8), hum_line);
+static void ui_action_status_screen(void)
+{
+    ui_screen_index = UI_PAGE_STATUS;
+    log_page_index = 0;
+    ui_page_deadline = xTaskGetTickCount() + ui_page_duration();
+}
 
-    // Temp arrow
-    u8g2_DrawXBM(&u8g2, OFFSET_X(19), OFFSET_Y(9), 23, 1, image_Temp_arrow_bits);
+static void ui_task(void *arg)
+{
+    const TickType_t frame_period = pdMS_TO_TICKS(UI_FRAME_PERIOD_MS);
+    TickType_t next_frame = xTaskGetTickCount() + frame_period;
 
-    // weather_temperature
-    u8g2_DrawXBM(&u8g2, OFFSET_X(0), OFFSET_Y(0), 16, 16, image_weather_temperature_bits);
+    ui_last_activity = xTaskGetTickCount();
 
-    // weather_humidity_white
-    u8g2_DrawXBM(&u8g2, OFFSET_X(0), OFFSET_Y(9), 19, 27, image_weather_humidity_white_bits);
+    while (1)
+    {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = ((int32_t)(next_frame - now) > 0) ? next_frame - now : 0;
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
 
-    // Hum arrow
-    u8g2_DrawXBM(&u8g2, OFFSET_X(11), OFFSET_Y(29), 31, 7, image_Hum_arrow_bits);
+        now = xTaskGetTickCount();
+        if ((int32_t)(now - next_frame) >= 0)
+        {
+            next_frame += frame_period;
+            if ((int32_t)(now - next_frame) >= 0)
+                next_frame = now + frame_period; // fell behind, don't catch up
+        }
 
-    // Layer 5
-    u8g2_DrawStr(&u8g2, OFFSET_X(18), OFFSET_Y(27), temp_line);
+        if (events & UI_EVENT_STATE)
+            ui_wake();
 
-    const uint8_t *state_icon = fsm_get_state_icon();
-    u8g2_DrawXBM(&u8g2, OFFSET_X(56), OFFSET_Y(16), 15, 16, state_icon);
+        button_event_t gesture;
+        while (button_get_event(&gesture))
+        {
+            // The first gesture only wakes a dark display
+            if (ui_wake())
+                continue;
+            button_run_action(gesture);
+        }
 
-    // Layer 11
-    u8g2_SetFont(&u8g2, u8g2_font_profont10_tr);
-    char fan_line[20];
-    char timer_line[20];
-    char state_line[20];
-    fsm_get_display_lines(fan_line, timer_line, state_line);
+        ui_power_update();
+#if !CONFIG_UI_BUFFER_FULL
+        ui_power_sync(); // the UI task owns the bus
+#endif
+
+        // "Loading..." stays until the first reading
+        ui_sample_t sample;
+        if (xQueuePeek(ui_sample_queue, &sample, 0) != pdTRUE)
+            continue;
+        now = xTaskGetTickCount();
+        if (!ui_pages_started)
+        {
+            ui_pages_started = true;
+            ui_page_deadline = now + ui_page_duration();
+        }
+        else if ((int32_t)(now - ui_page_deadline) >= 0)
+        {
+            ui_next_page();
+            ui_page_deadline = now + ui_page_duration();
+        }
 
-    u8g2_DrawStr(&u8g2, OFFSET_X(42), OFFSET_Y(39), timer_line);
+        // Nothing is drawn for a dark panel
+        if (ui_power_wanted == UI_POWER_OFF)
+            continue;
 
-    if (!fsm_is_fan_on())
-    {
-        // choice_bullet_off
-        u8g2_DrawXBM(&u8g2, OFFSET_X(57), OFFSET_Y(0), 15, 16, image_choice_bullet_off_bits);
+        power_boost_begin();
+        if (ui_screen_index == UI_PAGE_LOGS)
+        {
+            draw_log_screen();
+        }
+        else
+        {
+            char temp_line[32];
+            char hum_line[32];
+            snprintf(temp_line, sizeof(temp_line), "%.1f", sample.temp);
+            snprintf(hum_line, sizeof(hum_line), "%.1f", sample.hum);
+            draw_current_state(temp_line, hum_line);
+        }
+        power_boost_end();
     }
-    else
+}
+
+// aht_read in two steps so the trace shows the conversion wait
+static esp_err_t sensor_read(float *temp, float *hum)
+{
+    TRACE_BEGIN(TRACE_SENSOR_READ);
+    TRACE_BEGIN(TRACE_SENSOR_TRIGGER);
+    esp_err_t err = aht_trigger();
+    TRACE_END(TRACE_SENSOR_TRIGGER);
+    if (err == ESP_OK)
     {
-        // choice_bullet_on
-        u8g2_DrawXBM(&u8g2, OFFSET_X(57), OFFSET_Y(0), 15, 16, image_choice_bullet_on_bits);
+        vTaskDelay(pdMS_TO_TICKS(AHT_MEASURE_MS));
+        TRACE_BEGIN(TRACE_SENSOR_FETCH);
+        err = aht_fetch(temp, hum);
+        TRACE_END(TRACE_SENSOR_FETCH);
     }
-
-    u8g2_SendBuffer(&u8g2);
+    TRACE_END(TRACE_SENSOR_READ);
+    return err;
 }
 
 void app_main(void)
@@ -221,95 +549,130 @@ void app_main(void)
         .intr_type = GPIO_INTR_DISABLE};
     gpio_config(&io_conf);
 
-    // Button
-    gpio_config_t btn_conf = {
-        .pin_bit_mask = 1ULL << BUTTON_GPIO,
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .intr_type = GPIO_INTR_NEGEDGE,
-    };
-    gpio_config(&btn_conf);
-    // Run the debounce task
-    xTaskCreate(check_button_task, "check_button_task", 2048, NULL, 10, NULL);
-
     // One single I2C for OLED + AHT10
-    my_i2c_master_init(I2C_MASTER_PORT, I2C_MASTER_SDA, I2C_MASTER_SCL);
+    i2c_master_init(&oled, I2C_MASTER_SDA, I2C_MASTER_SCL, -1);
+#if CONFIG_MICROBENCH
+    // Benchmark boot: the ssd1306 driver gets the panel, no UI, no sensor loop
+    ssd1306_init(&oled, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    fsm_init();
+    microbench_run(&oled);
+    return;
+#endif
+    u8g2_ssd1306_hal_init(&oled);
     time_sync_init();
 
-    u8g2_Setup_ssd1306_i2c_128x64_noname_f(
+    UI_U8G2_SETUP(
         &u8g2,
         U8G2_R0,
-        u8g2_esp32_i2c_byte_cb,
-        u8g2_esp32_gpio_and_delay_cb);
+        u8g2_ssd1306_i2c_byte_cb,
+        u8g2_ssd1306_gpio_and_delay_cb);
     u8g2_InitDisplay(&u8g2);
     u8g2_SetPowerSave(&u8g2, 0);
-    u8g2_ClearBuffer(&u8g2);
-
-    u8g2_SetFont(&u8g2, u8g2_font_profont11_tr);
-    u8g2_DrawStr(&u8g2, DISPLAY_OFFSET_X + 0, 32, "Loading...");
-    u8g2_SendBuffer(&u8g2);
-
-    aht_init(I2C_MASTER_PORT);
+#if CONFIG_UI_BUFFER_FULL
+    ui_flush_init();
+#endif
+    ui_present(render_loading, NULL, &ui_budget_loading);
+
+    ui_sample_queue = xQueueCreate(1, sizeof(ui_sample_t));
+    xTaskCreate(ui_task, "ui_task", 4096, NULL, UI_TASK_PRIORITY, &ui_task_handle);
+
+    // Button gestures are handled by the UI task
+    button_set_action(BUTTON_SHORT_PRESS, BUTTON_SHORT_ACTION);
+    button_set_action(BUTTON_LONG_PRESS, BUTTON_LONG_ACTION);
+    button_set_action(BUTTON_DOUBLE_CLICK, BUTTON_DOUBLE_ACTION);
+    button_init(BUTTON_GPIO, ui_task_handle, UI_EVENT_BUTTON);
+
+    power_init();
+    aht_init(oled._i2c_bus_handle);
     vTaskDelay(pdMS_TO_TICKS(200));
     fsm_init();
+#if CONFIG_TELEMETRY
+    telemetry_init();
+#endif
 
     float temp = 0.0, hum = 0.0;
     printf("Scanning I2C bus...\n");
     for (uint8_t addr = 1; addr < 127; addr++)
     {
-        uint8_t dummy = 0;
-        esp_err_t ret = i2c_master_write_to_device(I2C_MASTER_PORT, addr, &dummy, 1, pdMS_TO_TICKS(10));
+        esp_err_t ret = i2c_master_probe(oled._i2c_bus_handle, addr, 10);
         if (ret == ESP_OK)
         {
             printf("Found I2C device at 0x%02X\n", addr);
         }
     }
 
-    int tick_count = 0;
-    int log_page_duration_ticks = 3;  // default for first 2 pages
+    const int64_t loop_period_us = SENSOR_PERIOD_MS * 1000LL;
+    int64_t last_loop_us = -1;
+    // Fixed-rate loop: the read time and light sleep wake-ups don't add up
+    TickType_t next_loop = xTaskGetTickCount();
+#if CONFIG_EVENT_TRACE
+    int64_t last_trace_dump_us = -TRACE_DUMP_MIN_INTERVAL_S * 1000000LL;
+#endif
+#if METRICS_REPORT_INTERVAL_S > 0
+    int64_t next_report_us = esp_timer_get_time() + METRICS_REPORT_INTERVAL_S * 1000000LL;
+#endif
 
     while (1)
     {
-        esp_err_t err = aht_read(&temp, &hum);
-        if (err == ESP_OK)
+        int64_t loop_us = esp_timer_get_time();
+        if (last_loop_us >= 0)
         {
-            char temp_line[32];
-            char hum_line[32];
-            snprintf(temp_line, sizeof(temp_line), "%.1f", temp);
-            snprintf(hum_line, sizeof(hum_line), "%.1f", hum);
-
-            fsm_update(hum);
-
-            tick_count++;
-            if (tick_count >= log_page_duration_ticks)
+            int64_t jitter = loop_us - last_loop_us - loop_period_us;
+            if (jitter < 0)
+                jitter = -jitter;
+            metrics_record(METRIC_LOOP_JITTER_US, jitter);
+#if CONFIG_EVENT_TRACE
+            if (jitter > TRACE_DUMP_JITTER_US)
             {
-                tick_count = 0;
-
-                if (ui_screen_index == UI_PAGE_LOGS)
+                TRACE_INSTANT(TRACE_LOOP_JITTER, jitter / 1000 > UINT16_MAX ? UINT16_MAX : jitter / 1000);
+                if (loop_us - last_trace_dump_us > TRACE_DUMP_MIN_INTERVAL_S * 1000000LL)
                 {
-                    log_page_index++;
-                    if (log_page_index >= log_total_pages)
-                    {
-                        log_page_index = 0;
-                        ui_screen_index = UI_PAGE_STATUS;
-                    }
-
-                    log_page_duration_ticks = (log_page_index < 2) ? 3 : 1;
-                }
-                else
-                {
-                    ui_screen_index = UI_PAGE_LOGS;
-                    log_page_index = 0;
-                    log_page_duration_ticks = 3;
+                    printf("Loop %lld ms late, trace follows\n", (long long)(jitter / 1000));
+                    trace_dump();
+                    last_trace_dump_us = loop_us;
                 }
             }
+#endif
+        }
+        last_loop_us = loop_us;
+
+        int64_t t = metrics_start();
+        esp_err_t err = sensor_read(&temp, &hum);
+        metrics_stop(METRIC_AHT_READ_US, t);
+        metrics_count(METRIC_AHT_READS, 1);
+        if (err == ESP_OK)
+        {
+            power_boost_begin();
+            fsm_state_t prev_state = fsm_get_state();
+            bool prev_fan = fsm_is_fan_on();
+            t = metrics_start();
+            TRACE_BEGIN(TRACE_FSM_UPDATE);
+            fsm_update(hum);
+            TRACE_END(TRACE_FSM_UPDATE);
+            metrics_stop(METRIC_FSM_UPDATE_US, t);
+
+            ui_sample_t sample = {.temp = temp, .hum = hum};
+            xQueueOverwrite(ui_sample_queue, &sample);
+            uint32_t events = UI_EVENT_SAMPLE;
+            if (fsm_get_state() != prev_state || fsm_is_fan_on() != prev_fan)
+                events |= UI_EVENT_STATE;
+            xTaskNotify(ui_task_handle, events, eSetBits);
+            power_boost_end();
+        }
+        else
+        {
+            metrics_count(METRIC_AHT_ERRORS, 1);
+        }
 
-            if (ui_screen_index == UI_PAGE_LOGS)
-                draw_log_screen();
-            else
-                draw_current_state(temp_line, hum_line);
+#if METRICS_REPORT_INTERVAL_S > 0
+        if (loop_us >= next_report_us)
+        {
+            metrics_print(); // the heap gauges are set by telemetry_sample
+            power_report();
+            next_report_us += METRICS_REPORT_INTERVAL_S * 1000000LL;
         }
+#endif
 
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        vTaskDelayUntil(&next_loop, SENSOR_PERIOD_MS / portTICK_PERIOD_MS);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "metrics.h"
+
+// The ESP32-C3 (RV32IMC) has no atomic instructions: __atomic read-modify-
+// writes are library calls that mask interrupts around each one. So a metric
+// updated by one task (METRIC_OWNED) uses plain word loads and stores, which
+// are single instructions here; only METRIC_SHARED ones pay for atomic adds,
+// one critical section per field. All fields are 32 bits for the same
+// reason. A reader may see a histogram between two of its field updates,
+// which is fine for monitoring.
+
+typedef struct {
+    uint32_t count;
+    int32_t value;
+    uint32_t sum;
+    uint32_t max;
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+} metric_t;
+
+static const char *const metric_names[METRIC_COUNT] = {
+#define METRIC_NAME(id, name, type, writer) name,
+    METRICS_LIST(METRIC_NAME)
+#undef METRIC_NAME
+};
+
+static const metric_type_t metric_types[METRIC_COUNT] = {
+#define METRIC_TYPE(id, name, type, writer) type,
+    METRICS_LIST(METRIC_TYPE)
+#undef METRIC_TYPE
+};
+
+static const metric_writer_t metric_writers[METRIC_COUNT] = {
+#define METRIC_WRITER(id, name, type, writer) writer,
+    METRICS_LIST(METRIC_WRITER)
+#undef METRIC_WRITER
+};
+
+static metric_t metrics[METRIC_COUNT];
+
+// field += n, atomically only when several tasks write the metric
+static inline void metrics_add(metric_id_t id, uint32_t *field, uint32_t n)
+{
+    if (metric_writers[id] == METRIC_SHARED)
+        __atomic_fetch_add(field, n, __ATOMIC_RELAXED);
+    else
+        __atomic_store_n(field, __atomic_load_n(field, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void metrics_count(metric_id_t id, uint32_t n)
+{
+    metrics_add(id, &metrics[id].count, n);
+}
+
+void metrics_set(metric_id_t id, int32_t value)
+{
+    __atomic_store_n(&metrics[id].value, value, __ATOMIC_RELAXED);
+}
+
+static int metrics_bucket(uint32_t value)
+{
+    int bucket = value ? 32 - __builtin_clz(value) : 0;
+    return bucket < METRICS_HIST_BUCKETS ? bucket : METRICS_HIST_BUCKETS - 1;
+}
+
+void metrics_record(metric_id_t id, uint32_t value)
+{
+    metric_t *m = &metrics[id];
+    metrics_add(id, &m->count, 1);
+    metrics_add(id, &m->sum, value);
+    metrics_add(id, &m->buckets[metrics_bucket(value)], 1);
+
+    uint32_t max = __atomic_load_n(&m->max, __ATOMIC_RELAXED);
+    if (value <= max)
+        return;
+    if (metric_writers[id] == METRIC_OWNED)
+        __atomic_store_n(&m->max, value, __ATOMIC_RELAXED);
+    else
+        while (value > max &&
+               !__atomic_compare_exchange_n(&m->max, &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+}
+
+bool metrics_get(metric_id_t id, metric_snapshot_t *out)
+{
+    if (id >= METRIC_COUNT)
+        return false;
+    metric_t *m = &metrics[id];
+    out->name = metric_names[id];
+    out->type = metric_types[id];
+    out->count = __atomic_load_n(&m->count, __ATOMIC_RELAXED);
+    out->value = __atomic_load_n(&m->value, __ATOMIC_RELAXED);
+    out->sum = __atomic_load_n(&m->sum, __ATOMIC_RELAXED);
+    out->max = __atomic_load_n(&m->max, __ATOMIC_RELAXED);
+    for (int b = 0; b < METRICS_HIST_BUCKETS; b++)
+        out->buckets[b] = __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+    return true;
+}
+
+uint32_t metrics_percentile(const metric_snapshot_t *snapshot, int percent)
+{
+    uint32_t total = 0;
+    for (int b = 0; b < METRICS_HIST_BUCKETS; b++)
+        total += snapshot->buckets[b];
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = ((uint64_t)total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < METRICS_HIST_BUCKETS - 1; b++)
+    {
+        seen += snapshot->buckets[b];
+        if (seen >= rank)
+            return b ? (1u << b) - 1 : 0;
+    }
+    return snapshot->max;
+}
+
+// One metric as a text line, snprintf semantics
+static int metrics_format_line(metric_id_t id, char *buf, size_t len)
+{
+    metric_snapshot_t s;
+    metrics_get(id, &s);
+    if (s.type == METRIC_COUNTER)
+        return snprintf(buf, len, "%s %" PRIu32 "\n", s.name, s.count);
+    if (s.type == METRIC_GAUGE)
+        return snprintf(buf, len, "%s %" PRId32 "\n", s.name, s.value);
+    return snprintf(buf, len, "%s n=%" PRIu32 " avg=%" PRIu32 " p50<=%" PRIu32 " p99<=%" PRIu32 " max=%" PRIu32 "\n",
+                    s.name, s.count, s.count ? s.sum / s.count : 0,
+                    metrics_percentile(&s, 50), metrics_percentile(&s, 99), s.max);
+}
+
+size_t metrics_format(char *buf, size_t len)
+{
+    if (len == 0)
+        return 0;
+    size_t used = 0;
+    buf[0] = '\0';
+
+    for (int id = 0; id < METRIC_COUNT && used < len; id++)
+    {
+        int n = metrics_format_line(id, buf + used, len - used);
+        if (n < 0)
+            break;
+        used += n;
+    }
+    return used < len ? used : len - 1;
+}
+
+// Line by line: called from the sensor loop, whose stack has no room for the
+// whole report
+void metrics_print(void)
+{
+    char line[128];
+    for (int id = 0; id < METRIC_COUNT; id++)
+    {
+        if (metrics_format_line(id, line, sizeof(line)) > 0)
+            printf("%s", line);
+    }
+}
+
+void metrics_reset(void)
+{
+    memset(metrics, 0, sizeof(metrics));
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+// Every metric is known at build time: the table below is the registry, so
+// there is no registration step and no lock. Latencies are in microseconds.
+// writer says whether one task updates the metric or several do (see
+// metrics.c for what that costs).
+//   X(id, name, type, writer)
+#define METRICS_LIST(X)                                                          \
+    X(METRIC_AHT_READ_US,     "aht.read_us",     METRIC_HISTOGRAM, METRIC_OWNED)  \
+    X(METRIC_AHT_READS,       "aht.reads",       METRIC_COUNTER,   METRIC_OWNED)  \
+    X(METRIC_AHT_ERRORS,      "aht.errors",      METRIC_COUNTER,   METRIC_OWNED)  \
+    X(METRIC_FSM_UPDATE_US,   "fsm.update_us",   METRIC_HISTOGRAM, METRIC_OWNED)  \
+    X(METRIC_NVS_WRITE_US,    "nvs.write_us",    METRIC_HISTOGRAM, METRIC_SHARED) \
+    X(METRIC_NVS_COMMIT_US,   "nvs.commit_us",   METRIC_HISTOGRAM, METRIC_SHARED) \
+    X(METRIC_UI_RENDER_US,    "ui.render_us",    METRIC_HISTOGRAM, METRIC_OWNED)  \
+    X(METRIC_UI_FLUSH_US,     "ui.flush_us",     METRIC_HISTOGRAM, METRIC_OWNED)  \
+    X(METRIC_UI_FRAMES,       "ui.frames",       METRIC_COUNTER,   METRIC_OWNED)  \
+    X(METRIC_LOOP_JITTER_US,  "loop.jitter_us",  METRIC_HISTOGRAM, METRIC_OWNED)  \
+    X(METRIC_HEAP_FREE,       "heap.free",       METRIC_GAUGE,     METRIC_OWNED)  \
+    X(METRIC_HEAP_MIN_FREE,   "heap.min_free",   METRIC_GAUGE,     METRIC_OWNED)  \
+    X(METRIC_HEAP_LARGEST,    "heap.largest",    METRIC_GAUGE,     METRIC_OWNED)
+
+typedef enum {
+    METRIC_COUNTER,   // only goes up
+    METRIC_GAUGE,     // last value set
+    METRIC_HISTOGRAM, // count, sum, max and log2 buckets
+} metric_type_t;
+
+typedef enum {
+    METRIC_OWNED,  // updated by one task only (ui.flush_us: the flush task or the UI task, by config)
+    METRIC_SHARED, // updated by several tasks (NVS: the sensor loop and time sync)
+} metric_writer_t;
+
+typedef enum {
+#define METRIC_ENUM(id, name, type, writer) id,
+    METRICS_LIST(METRIC_ENUM)
+#undef METRIC_ENUM
+    METRIC_COUNT,
+} metric_id_t;
+
+// Bucket b holds samples in [2^(b-1), 2^b) us, bucket 0 holds 0, the last one
+// everything from 2^(METRICS_HIST_BUCKETS-2) us (~0.5 s) up
+#define METRICS_HIST_BUCKETS 21
+
+typedef struct {
+    const char *name;
+    metric_type_t type;
+    uint32_t count;  // counter value, samples for histograms
+    int32_t value;   // gauge value
+    uint32_t sum;    // histograms: sum of samples, wraps after ~71 min in total
+    uint32_t max;
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+} metric_snapshot_t;
+
+void metrics_count(metric_id_t id, uint32_t n);
+void metrics_set(metric_id_t id, int32_t value);
+void metrics_record(metric_id_t id, uint32_t value);
+
+// Time a section: int64_t t = metrics_start(); ...; metrics_stop(id, t);
+static inline int64_t metrics_start(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline void metrics_stop(metric_id_t id, int64_t start)
+{
+    metrics_record(id, (uint32_t)(esp_timer_get_time() - start));
+}
+
+bool metrics_get(metric_id_t id, metric_snapshot_t *out);
+uint32_t metrics_percentile(const metric_snapshot_t *snapshot, int percent); // bucket upper bound
+size_t metrics_format(char *buf, size_t len); // one line per metric
+void metrics_print(void);
+void metrics_reset(void);
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "aht.h"
+#include "fsm.h"
+#include "microbench.h"
+#include "bus_budget.h"
+
+// Every benchmark is calibrated to run at least BENCH_MIN_RUN_US, then
+// timed BENCH_RUNS times; the median is reported so a preempted run does
+// not move the number. The buffer-only (_ssd1306_*) and wrap_arround
+// (delay -1) cases never touch the bus.
+#define BENCH_MIN_RUN_US 100000
+#define BENCH_RUNS 7
+#define BENCH_MAX_ITERATIONS (1u << 24)
+
+typedef void (*bench_fn_t)(uint32_t iterations);
+
+static SSD1306_t *bench_dev;
+static volatile uint32_t bench_sink; // keeps results alive
+
+// 16x16, 2 bytes per row, MSB first as for _ssd1306_bitmaps
+static const uint8_t bench_icon[32] = {
+    0x07, 0xE0, 0x18, 0x18, 0x20, 0x04, 0x40, 0x02, 0x40, 0x02, 0x80, 0x01, 0x80, 0x01, 0x8F, 0xF1,
+    0x80, 0x01, 0x80, 0x01, 0x40, 0x02, 0x40, 0x02, 0x20, 0x04, 0x18, 0x18, 0x07, 0xE0, 0x00, 0x00,
+};
+
+static void bench_bitmaps(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        _ssd1306_bitmaps(bench_dev, 3 + (i & 7), 5, bench_icon, 16, 16, false); // unaligned on purpose
+}
+
+// The bit-at-a-time copy _ssd1306_bitmaps used before the blitter, kept as
+// the reference for ssd1306_bitmaps (logging and range warnings left out)
+static void bitmaps_bitwise(SSD1306_t *dev, int xpos, int ypos, const uint8_t *bitmap, int width, int height, bool invert)
+{
+    int _width = width / 8;
+    int page = ypos / 8;
+    int _seg = xpos;
+    int dstBits = ypos % 8;
+    int offset = 0;
+    for (int _height = 0; _height < height; _height++)
+    {
+        for (int index = 0; index < _width; index++)
+        {
+            for (int srcBits = 7; srcBits >= 0; srcBits--)
+            {
+                uint8_t wk0 = dev->_page[page]._segs[_seg];
+                if (dev->_flip)
+                    wk0 = ssd1306_rotate_byte(wk0);
+                uint8_t wk1 = bitmap[index + offset];
+                if (invert)
+                    wk1 = ~wk1;
+                uint8_t wk2 = ssd1306_copy_bit(wk1, srcBits, wk0, dstBits);
+                if (dev->_flip)
+                    wk2 = ssd1306_rotate_byte(wk2);
+                if (_seg >= dev->_width || page >= dev->_pages)
+                    break;
+                dev->_page[page]._segs[_seg] = wk2;
+                _seg++;
+            }
+        }
+        offset = offset + _width;
+        dstBits++;
+        _seg = xpos;
+        if (dstBits == 8)
+        {
+            page++;
+            dstBits = 0;
+        }
+    }
+}
+
+static void bench_bitmaps_bitwise(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        bitmaps_bitwise(bench_dev, 3 + (i & 7), 5, bench_icon, 16, 16, false);
+}
+
+static void bench_wrap(ssd1306_scroll_type_t scroll, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        ssd1306_wrap_arround(bench_dev, scroll, 0, bench_dev->_pages - 1, -1);
+}
+
+static void bench_wrap_right(uint32_t n) { bench_wrap(SCROLL_RIGHT, n); }
+static void bench_wrap_left(uint32_t n) { bench_wrap(SCROLL_LEFT, n); }
+static void bench_wrap_up(uint32_t n) { bench_wrap(SCROLL_UP, n); }
+static void bench_wrap_down(uint32_t n) { bench_wrap(SCROLL_DOWN, n); }
+static void bench_wrap_page_up(uint32_t n) { bench_wrap(PAGE_SCROLL_UP, n); }
+static void bench_wrap_page_down(uint32_t n) { bench_wrap(PAGE_SCROLL_DOWN, n); }
+
+static void bench_text_buffer(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        _ssd1306_display_text(bench_dev, i % bench_dev->_pages, "FAN ON", 6, i & 1);
+}
+
+// Includes sending the changed bytes, on the bus or to the virtual panel
+static void bench_text(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        ssd1306_display_text(bench_dev, 0, (i & 1) ? "FAN ON " : "FAN OFF", 7, false);
+}
+
+static void bench_rotate_image(uint32_t n)
+{
+    uint8_t image[8] = {0x18, 0x3C, 0x7E, 0xFF, 0x18, 0x18, 0x18, 0x00};
+    for (uint32_t i = 0; i < n; i++)
+        ssd1306_rotate_image(image, i & 1);
+    bench_sink = image[0];
+}
+
+static void bench_aht_convert(uint32_t n)
+{
+    uint8_t data[6] = {0x1C, 0x8F, 0x5C, 0x25, 0xE3, 0x54};
+    float temp = 0;
+    float hum = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        data[5] = i;
+        aht_convert(data, &temp, &hum);
+    }
+    bench_sink = (uint32_t)(temp + hum);
+}
+
+// Dry air in IDLE: every check runs, no transition (that would write NVS)
+static void bench_fsm_update(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        fsm_update(40.0f + (i & 7));
+}
+
+static void bench_log_line(uint32_t n)
+{
+    char line[64];
+    for (uint32_t i = 0; i < n; i++)
+        fsm_format_log_line(line, sizeof(line), "IDLE (from WAITING)", 55.0f + (i & 15));
+    bench_sink = line[0];
+}
+
+static const struct
+{
+    const char *name;
+    bench_fn_t fn;
+} benches[] = {
+    {"ssd1306_bitmaps", bench_bitmaps},
+    {"ssd1306_bitmaps.bitwise_reference", bench_bitmaps_bitwise},
+    {"ssd1306_wrap_arround.right", bench_wrap_right},
+    {"ssd1306_wrap_arround.left", bench_wrap_left},
+    {"ssd1306_wrap_arround.up", bench_wrap_up},
+    {"ssd1306_wrap_arround.down", bench_wrap_down},
+    {"ssd1306_wrap_arround.page_up", bench_wrap_page_up},
+    {"ssd1306_wrap_arround.page_down", bench_wrap_page_down},
+    {"ssd1306_display_text.buffer", bench_text_buffer},
+    {"ssd1306_display_text", bench_text},
+    {"ssd1306_rotate_image", bench_rotate_image},
+    {"aht_convert", bench_aht_convert},
+    {"fsm_update", bench_fsm_update},
+    {"fsm_format_log_line", bench_log_line},
+};
+
+static int64_t bench_time(bench_fn_t fn, uint32_t iterations)
+{
+    int64_t start = esp_timer_get_time();
+    fn(iterations);
+    return esp_timer_get_time() - start;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#if CONFIG_UI_BUS_BUDGET_CHECK
+static void bench_budget(SSD1306_t *dev, const bus_budget_t *budget, ssd1306_bus_stats_t stats)
+{
+    printf("{\"budget\":\"%s\",\"bytes\":%lu,\"max_bytes\":%lu,\"transactions\":%lu,\"wire_us\":%llu}\n",
+           budget->name, (unsigned long)stats.bytes, (unsigned long)budget->max_bytes,
+           (unsigned long)stats.transactions, (unsigned long long)(stats.wire_ns / 1000));
+    bus_budget_check(budget, stats);
+}
+
+// Traffic of single driver operations, aborts on overrun
+static void bench_budgets(SSD1306_t *dev)
+{
+    const bus_budget_t text = {"ssd1306_display_text 16 chars", BUS_BUDGET_TEXT_LINE(dev->_width)};
+    ssd1306_clear_screen(dev, false);
+    ssd1306_take_bus_stats(dev);
+    ssd1306_display_text(dev, 0, "0123456789ABCDEF", 16, false);
+    bench_budget(dev, &text, ssd1306_take_bus_stats(dev));
+
+    const bus_budget_t fadeout = {"ssd1306_fadeout", BUS_BUDGET_FADEOUT(dev->_pages, dev->_width)};
+    for (int page = 0; page < dev->_pages; page++)
+        ssd1306_display_text(dev, page, "0123456789ABCDEF", 16, true);
+    ssd1306_take_bus_stats(dev);
+    ssd1306_fadeout(dev);
+    bench_budget(dev, &fadeout, ssd1306_take_bus_stats(dev));
+}
+#endif
+
+void microbench_run(SSD1306_t *dev)
+{
+    bench_dev = dev;
+    printf("Running %d microbenchmarks\n", (int)(sizeof(benches) / sizeof(benches[0])));
+
+    for (int b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+    {
+        ssd1306_clear_screen(dev, false);
+
+        uint32_t iterations = 1;
+        while (iterations < BENCH_MAX_ITERATIONS && bench_time(benches[b].fn, iterations) < BENCH_MIN_RUN_US)
+            iterations *= 2;
+
+        double ns_per_op[BENCH_RUNS];
+        for (int run = 0; run < BENCH_RUNS; run++)
+        {
+            vTaskDelay(1); // let the idle task feed the watchdog
+            ns_per_op[run] = bench_time(benches[b].fn, iterations) * 1000.0 / iterations;
+        }
+        qsort(ns_per_op, BENCH_RUNS, sizeof(double), compare_double);
+
+        printf("{\"bench\":\"%s\",\"ns_per_op\":%.1f,\"min_ns_per_op\":%.1f,\"iterations\":%lu}\n",
+               benches[b].name, ns_per_op[BENCH_RUNS / 2], ns_per_op[0], (unsigned long)iterations);
+    }
+
+#if CONFIG_UI_BUS_BUDGET_CHECK
+    bench_budgets(dev);
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ssd1306.h"
+
+// Times the CPU-bound hot paths and prints one JSON object per benchmark:
+//   {"bench":"<name>","ns_per_op":<median>,"min_ns_per_op":<best>,"iterations":<per run>}
+// dev must be initialised with ssd1306_init, it is drawn over. fsm_init must
+// have run. With CONFIG_UI_BUS_BUDGET_CHECK the bus budgets of single driver
+// operations are printed and checked afterwards.
+void microbench_run(SSD1306_t *dev);
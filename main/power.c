@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_log.h"
+#include "power.h"
+
+static const char *TAG = "power";
+
+// DFS between the crystal and the full clock; the I2C and Wi-Fi drivers hold
+// their own locks while they need a fixed APB clock
+#define POWER_CPU_MAX_MHZ 160
+#define POWER_CPU_MIN_MHZ 40
+
+static esp_pm_lock_handle_t boost_lock;
+
+void power_init(void)
+{
+    esp_pm_config_t config = {
+        .max_freq_mhz = POWER_CPU_MAX_MHZ,
+        .min_freq_mhz = POWER_CPU_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK)
+    {
+        // Without CONFIG_FREERTOS_USE_TICKLESS_IDLE light sleep is refused
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &boost_lock));
+
+    // The button arms its pin with gpio_wakeup_enable
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+}
+
+void power_boost_begin(void)
+{
+    if (boost_lock != NULL)
+        esp_pm_lock_acquire(boost_lock);
+}
+
+void power_boost_end(void)
+{
+    if (boost_lock != NULL)
+        esp_pm_lock_release(boost_lock);
+}
+
+void power_report(void)
+{
+#if CONFIG_PM_PROFILING
+    // Per lock and per mode time since boot, the SLEEP row is light sleep
+    esp_pm_dump_locks(stdout);
+#endif
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+// Automatic light sleep (CONFIG_PM_ENABLE): the chip sleeps whenever every
+// task is blocked, esp_timer/FreeRTOS timeouts and the button pin wake it.
+// Work that has a deadline runs between power_boost_begin/end at the full
+// CPU clock, so it finishes quickly and the chip gets back to sleep.
+#if CONFIG_PM_ENABLE
+void power_init(void);
+void power_boost_begin(void);
+void power_boost_end(void);
+void power_report(void); // time per power mode, needs CONFIG_PM_PROFILING
+#else
+static inline void power_init(void) {}
+static inline void power_boost_begin(void) {}
+static inline void power_boost_end(void) {}
+static inline void power_report(void) {}
+#endif
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "telemetry.h"
+#include "metrics.h"
+
+// uxTaskGetSystemState needs CONFIG_FREERTOS_USE_TRACE_FACILITY, the runtime
+// column CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (both selected by
+// CONFIG_TELEMETRY). The monitor runs at the lowest priority above idle, so
+// it never delays the sensor loop or the UI.
+#define TELEMETRY_TASK_PRIORITY 1
+#define TELEMETRY_TASK_STACK 3072
+
+static telemetry_snapshot_t history[TELEMETRY_HISTORY];
+static uint32_t history_seq; // snapshots taken, the latest is history_seq - 1
+static SemaphoreHandle_t history_mutex;
+static TaskStatus_t task_status[TELEMETRY_MAX_TASKS + 4]; // monitor only
+static uint8_t warned_flags; // printed once until they clear
+
+void telemetry_sample(void)
+{
+    telemetry_snapshot_t snap;
+    memset(&snap, 0, sizeof(snap));
+
+    uint32_t total_runtime = 0;
+    UBaseType_t n = uxTaskGetSystemState(task_status, sizeof(task_status) / sizeof(task_status[0]), &total_runtime);
+    if (n == 0) // array too small, the kernel fills nothing
+        snap.header.flags |= TELEMETRY_FLAG_TASKS_TRUNCATED;
+    if (n > TELEMETRY_MAX_TASKS)
+    {
+        n = TELEMETRY_MAX_TASKS;
+        snap.header.flags |= TELEMETRY_FLAG_TASKS_TRUNCATED;
+    }
+
+    for (UBaseType_t i = 0; i < n; i++)
+    {
+        const TaskStatus_t *ts = &task_status[i];
+        telemetry_task_t *t = &snap.tasks[i];
+        strncpy(t->name, ts->pcTaskName, TELEMETRY_NAME_LEN);
+        t->runtime = ts->ulRunTimeCounter;
+        // StackType_t is a byte on the ESP ports, so the mark is in bytes
+        t->stack_free = ts->usStackHighWaterMark > UINT16_MAX ? UINT16_MAX : ts->usStackHighWaterMark;
+        t->priority = ts->uxCurrentPriority;
+        t->state = ts->eCurrentState;
+        if (t->stack_free < TELEMETRY_STACK_WARN)
+            snap.header.flags |= TELEMETRY_FLAG_LOW_STACK;
+    }
+
+    snap.header.magic = TELEMETRY_MAGIC;
+    snap.header.version = TELEMETRY_VERSION;
+    snap.header.task_count = n;
+    snap.header.uptime_ms = esp_timer_get_time() / 1000;
+    snap.header.total_runtime = total_runtime;
+    snap.header.heap_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    snap.header.heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    snap.header.heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    if ((uint64_t)snap.header.heap_largest * 100 < (uint64_t)snap.header.heap_free * TELEMETRY_FRAGMENT_WARN_PCT)
+        snap.header.flags |= TELEMETRY_FLAG_FRAGMENTED;
+
+    metrics_set(METRIC_HEAP_FREE, snap.header.heap_free);
+    metrics_set(METRIC_HEAP_MIN_FREE, snap.header.heap_min_free);
+    metrics_set(METRIC_HEAP_LARGEST, snap.header.heap_largest);
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    snap.header.seq = history_seq;
+    memcpy(&history[history_seq % TELEMETRY_HISTORY], &snap, telemetry_snapshot_size(&snap));
+    history_seq++;
+    xSemaphoreGive(history_mutex);
+
+    uint8_t warnings = snap.header.flags & (TELEMETRY_FLAG_LOW_STACK | TELEMETRY_FLAG_FRAGMENTED);
+    if (warnings & ~warned_flags)
+        telemetry_print(&snap);
+    warned_flags = warnings;
+}
+
+bool telemetry_get(int age, telemetry_snapshot_t *out)
+{
+    bool found = false;
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    if (age >= 0 && age < TELEMETRY_HISTORY && (uint32_t)age < history_seq)
+    {
+        const telemetry_snapshot_t *snap = &history[(history_seq - 1 - age) % TELEMETRY_HISTORY];
+        memcpy(out, snap, telemetry_snapshot_size(snap));
+        found = true;
+    }
+    xSemaphoreGive(history_mutex);
+    return found;
+}
+
+void telemetry_print(const telemetry_snapshot_t *snapshot)
+{
+    const telemetry_header_t *h = &snapshot->header;
+    printf("Telemetry #%" PRIu32 " at %" PRIu32 " ms: heap free %" PRIu32 ", min %" PRIu32 ", largest block %" PRIu32 "%s%s%s\n",
+           h->seq, h->uptime_ms, h->heap_free, h->heap_min_free, h->heap_largest,
+           (h->flags & TELEMETRY_FLAG_LOW_STACK) ? " LOW STACK" : "",
+           (h->flags & TELEMETRY_FLAG_FRAGMENTED) ? " FRAGMENTED" : "",
+           (h->flags & TELEMETRY_FLAG_TASKS_TRUNCATED) ? " (tasks truncated)" : "");
+    for (int i = 0; i < h->task_count; i++)
+    {
+        const telemetry_task_t *t = &snapshot->tasks[i];
+        uint32_t permille = h->total_runtime ? (uint64_t)t->runtime * 1000 / h->total_runtime : 0;
+        printf("  %-8.8s prio %2u stack free %5u cpu %3" PRIu32 ".%" PRIu32 "%%\n",
+               t->name, t->priority, t->stack_free, permille / 10, permille % 10);
+    }
+}
+
+static void telemetry_task(void *arg)
+{
+    TickType_t last = xTaskGetTickCount();
+    while (1)
+    {
+        telemetry_sample();
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(TELEMETRY_PERIOD_S * 1000));
+    }
+}
+
+void telemetry_init(void)
+{
+    history_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(telemetry_task, "telemetry", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, NULL);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Task, stack and heap snapshots taken by a low-priority monitor task and
+// kept in RAM, TELEMETRY_HISTORY of them, oldest overwritten first.
+#define TELEMETRY_PERIOD_S 60
+#define TELEMETRY_HISTORY 16
+#define TELEMETRY_MAX_TASKS 12
+#define TELEMETRY_NAME_LEN 8 // truncated, not NUL terminated when full
+
+// Snapshots are packed little-endian records meant to be dumped as is:
+// a header followed by task_count task records.
+#define TELEMETRY_MAGIC 0x54 // 'T'
+#define TELEMETRY_VERSION 1
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic;
+    uint8_t version;
+    uint8_t task_count;
+    uint8_t flags;           // TELEMETRY_FLAG_*
+    uint32_t seq;
+    uint32_t uptime_ms;
+    uint32_t total_runtime;  // run time counter, same unit as the tasks'
+    uint32_t heap_free;
+    uint32_t heap_min_free;  // lowest since boot
+    uint32_t heap_largest;   // largest free block
+} telemetry_header_t;
+
+typedef struct __attribute__((packed))
+{
+    char name[TELEMETRY_NAME_LEN];
+    uint32_t runtime;        // cumulative, diff two snapshots for load
+    uint16_t stack_free;     // high-water mark, bytes never used
+    uint8_t priority;
+    uint8_t state;           // eTaskState
+} telemetry_task_t;
+
+typedef struct __attribute__((packed))
+{
+    telemetry_header_t header;
+    telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+} telemetry_snapshot_t;
+
+#define TELEMETRY_FLAG_TASKS_TRUNCATED (1 << 0) // more than TELEMETRY_MAX_TASKS
+#define TELEMETRY_FLAG_LOW_STACK       (1 << 1) // a task is under TELEMETRY_STACK_WARN
+#define TELEMETRY_FLAG_FRAGMENTED      (1 << 2) // largest block under TELEMETRY_FRAGMENT_WARN_PCT of free
+
+#define TELEMETRY_STACK_WARN 256
+#define TELEMETRY_FRAGMENT_WARN_PCT 25
+
+void telemetry_init(void);
+void telemetry_sample(void); // take a snapshot now, from any task
+
+// Size of a stored snapshot: header plus the tasks it holds
+static inline size_t telemetry_snapshot_size(const telemetry_snapshot_t *snapshot)
+{
+    return sizeof(telemetry_header_t) + snapshot->header.task_count * sizeof(telemetry_task_t);
+}
+
+// Copy the snapshot `age` samples back (0 = latest), false if there is none
+bool telemetry_get(int age, telemetry_snapshot_t *out);
+void telemetry_print(const telemetry_snapshot_t *snapshot);
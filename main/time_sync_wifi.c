@@ -1,15 +1,149 @@
 #include <time.h>
+#include <stddef.h>
+#include <sys/time.h>
 #include "esp_log.h"
 #include "esp_sntp.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rtc_time.h"
+#include "esp_rom_crc.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_sntp.h"
+#include "time_sync_wifi.h"
+#include "metrics.h"
+#include "event_trace.h"
 
 static const char *TAG = "time_sync";
 
+#define TIME_ANCHOR_MAGIC 0x54494D45      // "TIME"
+#define TIME_SYNC_ERROR_MS 500            // SNTP accuracy we assume at the moment of sync
+#define TIME_DRIFT_PPM 5000               // worst case for the calibrated RC slow clock across resets
+#define TIME_MAX_ERROR_MS (5 * 60 * 1000) // restored time is trusted until the bound grows past this
+#define TIME_NVS_SAVE_INTERVAL_US (6 * 3600 * 1000000LL)
+#define WIFI_LISTEN_INTERVAL 10           // beacons slept through in max modem power save
+
+// Last SNTP sync: wall-clock time together with the RTC timer (survives soft
+// resets) and esp_timer (restarts with every boot) readings taken at that moment.
+typedef struct {
+    uint32_t magic;
+    int64_t epoch_us;
+    uint64_t rtc_us;
+    int64_t timer_us;
+    uint32_t resets;   // reboots since the sync, lowers the confidence
+    uint32_t crc;
+} time_anchor_t;
+
+static RTC_NOINIT_ATTR time_anchor_t s_rtc_anchor;
+static time_source_t s_time_source = TIME_SOURCE_NONE;
+static int64_t s_last_nvs_save_us = -1;
+
+// --- 0. Keep the last sync across reboots ---
+static uint32_t anchor_crc(const time_anchor_t *anchor)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)anchor, offsetof(time_anchor_t, crc));
+}
+
+static bool anchor_is_valid(const time_anchor_t *anchor)
+{
+    return anchor->magic == TIME_ANCHOR_MAGIC && anchor->crc == anchor_crc(anchor);
+}
+
+static void anchor_save_nvs(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open("time_sync", NVS_READWRITE, &handle) != ESP_OK)
+        return;
+
+    int64_t t = metrics_start();
+    nvs_set_blob(handle, "anchor", &s_rtc_anchor, sizeof(s_rtc_anchor));
+    metrics_stop(METRIC_NVS_WRITE_US, t);
+    t = metrics_start();
+    TRACE_BEGIN(TRACE_NVS_COMMIT);
+    nvs_commit(handle);
+    TRACE_END(TRACE_NVS_COMMIT);
+    metrics_stop(METRIC_NVS_COMMIT_US, t);
+    nvs_close(handle);
+}
+
+static bool anchor_load_nvs(time_anchor_t *anchor)
+{
+    nvs_handle_t handle;
+    if (nvs_open("time_sync", NVS_READONLY, &handle) != ESP_OK)
+        return false;
+
+    size_t len = sizeof(*anchor);
+    esp_err_t err = nvs_get_blob(handle, "anchor", anchor, &len);
+    nvs_close(handle);
+    return err == ESP_OK && len == sizeof(*anchor) && anchor_is_valid(anchor);
+}
+
+static void time_sync_notification_cb(struct timeval *tv)
+{
+    s_rtc_anchor.magic = TIME_ANCHOR_MAGIC;
+    s_rtc_anchor.epoch_us = (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+    s_rtc_anchor.rtc_us = esp_rtc_get_time_us();
+    s_rtc_anchor.timer_us = esp_timer_get_time();
+    s_rtc_anchor.resets = 0;
+    s_rtc_anchor.crc = anchor_crc(&s_rtc_anchor);
+    s_time_source = TIME_SOURCE_SNTP;
+    TRACE_INSTANT(TRACE_SNTP_SYNCED, 0);
+
+    // SNTP re-syncs every hour; flash only needs an occasional copy for cold boots
+    if (s_last_nvs_save_us < 0 || s_rtc_anchor.timer_us - s_last_nvs_save_us > TIME_NVS_SAVE_INTERVAL_US)
+    {
+        anchor_save_nvs();
+        s_last_nvs_save_us = s_rtc_anchor.timer_us;
+    }
+}
+
+// After a soft reset (watchdog, panic, esp_restart) RTC memory and the RTC timer
+// survive, so the wall clock is rebuilt from the last sync plus the RTC time
+// elapsed since. A cold boot only gets the last synced epoch back from NVS.
+static void restore_time(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool warm = reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT && reason != ESP_RST_UNKNOWN;
+
+    if (warm && anchor_is_valid(&s_rtc_anchor) && esp_rtc_get_time_us() >= s_rtc_anchor.rtc_us)
+    {
+        int64_t now_us = s_rtc_anchor.epoch_us + (int64_t)(esp_rtc_get_time_us() - s_rtc_anchor.rtc_us);
+        struct timeval tv = {
+            .tv_sec = now_us / 1000000,
+            .tv_usec = now_us % 1000000,
+        };
+        settimeofday(&tv, NULL);
+
+        s_rtc_anchor.resets++;
+        s_rtc_anchor.crc = anchor_crc(&s_rtc_anchor);
+        s_time_source = TIME_SOURCE_RTC;
+        ESP_LOGI(TAG, "Time restored from RTC memory (reset #%lu since sync, error <= %lld ms)",
+                 (unsigned long)s_rtc_anchor.resets, (long long)time_get_error_bound_ms());
+        return;
+    }
+
+    time_anchor_t stored;
+    if (anchor_load_nvs(&stored))
+    {
+        // Elapsed time since the sync is unknown, keep it only as a lower bound
+        s_rtc_anchor = stored;
+        s_rtc_anchor.resets++;
+        s_rtc_anchor.rtc_us = esp_rtc_get_time_us();
+        s_rtc_anchor.crc = anchor_crc(&s_rtc_anchor);
+        s_time_source = TIME_SOURCE_LAST_KNOWN;
+        ESP_LOGI(TAG, "Cold boot, last synced epoch %lld", (long long)(stored.epoch_us / 1000000));
+        return;
+    }
+
+    s_rtc_anchor.magic = 0;
+    s_time_source = TIME_SOURCE_NONE;
+}
+
 // --- 1. Initialize SNTP ---
 static void initialize_sntp(void)
 {
@@ -18,6 +152,7 @@ static void initialize_sntp(void)
 
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     esp_sntp_setservername(0, "pool.ntp.org");
+    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
 
     esp_sntp_init();
 }
@@ -32,17 +167,20 @@ static void obtain_time(void)
     int retry = 0;
     const int retry_count = 10;
 
-    while (timeinfo.tm_year < (2020 - 1900) && ++retry < retry_count)
+    // The clock may already look valid after an RTC restore, and s_time_source
+    // is still SNTP after an earlier sync, so wait for this sync itself. The
+    // status reads COMPLETED only once, keep it.
+    bool synced;
+    while (!(synced = (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED)) && ++retry < retry_count)
     {
         ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
+        TRACE_INSTANT(TRACE_SNTP_WAIT, retry);
         vTaskDelay(2000 / portTICK_PERIOD_MS);
-        time(&now);
-        setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
-        tzset();
-        localtime_r(&now, &timeinfo);
     }
+    time(&now);
+    localtime_r(&now, &timeinfo);
 
-    if (timeinfo.tm_year >= (2020 - 1900))
+    if (synced)
     {
         ESP_LOGI(TAG, "✅ Time synced: %s", asctime(&timeinfo));
     }
@@ -63,21 +201,57 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
     {
         ESP_LOGI(TAG, "Wi-Fi connected");
+        TRACE_INSTANT(TRACE_WIFI_CONNECTED, 0);
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ESP_LOGI(TAG, "Got IP — starting time sync...");
+        TRACE_INSTANT(TRACE_WIFI_GOT_IP, 0);
         obtain_time(); // 👈 Sync time when IP is assigned
     }
 }
 
 bool time_is_valid(void)
 {
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    return (timeinfo.tm_year >= (2020 - 1900));
+    switch (s_time_source)
+    {
+    case TIME_SOURCE_SNTP:
+        return true;
+    case TIME_SOURCE_RTC:
+        return time_get_error_bound_ms() <= TIME_MAX_ERROR_MS;
+    default:
+        return false;
+    }
+}
+
+time_source_t time_get_source(void)
+{
+    return s_time_source;
+}
+
+int64_t time_get_sync_age_s(void)
+{
+    if (s_time_source != TIME_SOURCE_SNTP && s_time_source != TIME_SOURCE_RTC)
+        return -1;
+    return (int64_t)(esp_rtc_get_time_us() - s_rtc_anchor.rtc_us) / 1000000;
+}
+
+int64_t time_get_error_bound_ms(void)
+{
+    if (s_time_source != TIME_SOURCE_SNTP && s_time_source != TIME_SOURCE_RTC)
+        return -1;
+    int64_t age_us = (int64_t)(esp_rtc_get_time_us() - s_rtc_anchor.rtc_us);
+    return TIME_SYNC_ERROR_MS + age_us / 1000 * TIME_DRIFT_PPM / 1000000;
+}
+
+uint32_t time_get_resets_since_sync(void)
+{
+    return s_time_source == TIME_SOURCE_NONE ? 0 : s_rtc_anchor.resets;
+}
+
+int64_t time_get_last_sync_epoch(void)
+{
+    return s_time_source == TIME_SOURCE_NONE ? -1 : s_rtc_anchor.epoch_us / 1000000;
 }
 
 // --- 4. Main entry point ---
@@ -92,6 +266,10 @@ void time_sync_init(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
+    tzset();
+    restore_time();
+
     // Initialize networking
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -121,11 +299,15 @@ void time_sync_init(void)
             .ssid = "Phone WiFi",
             .password = "password",
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .listen_interval = WIFI_LISTEN_INTERVAL,
         },
     };
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // The link only carries the hourly SNTP request, let the radio sleep
+    // between beacons so automatic light sleep isn't held off
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MAX_MODEM));
 
     ESP_LOGI(TAG, "Wi-Fi initialization finished.");
 }
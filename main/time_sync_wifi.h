@@ -1,5 +1,21 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    TIME_SOURCE_NONE,       // wall-clock time unknown
+    TIME_SOURCE_LAST_KNOWN, // cold boot: only the last synced epoch (from NVS) is known
+    TIME_SOURCE_RTC,        // restored from RTC memory after a soft reset
+    TIME_SOURCE_SNTP,       // synced over the network during this boot
+} time_source_t;
+
 void time_sync_init(void);     // call this during setup
-bool time_is_valid(void);      // to check if time was synced
-void print_current_time(void); // (optional) for debugging
\ No newline at end of file
+bool time_is_valid(void);      // to check if time was synced (or restored with a small enough error)
+void print_current_time(void); // (optional) for debugging
+
+time_source_t time_get_source(void);
+int64_t time_get_sync_age_s(void);         // seconds since the last SNTP sync, -1 if unknown
+int64_t time_get_error_bound_ms(void);     // upper bound of the clock error, -1 if the clock is not set
+uint32_t time_get_resets_since_sync(void); // reboots survived by the last sync
+int64_t time_get_last_sync_epoch(void);    // last synced Unix time, -1 if unknown
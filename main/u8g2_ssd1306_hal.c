@@ -0,0 +1,105 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "u8g2_ssd1306_hal.h"
+
+static const char *TAG = "u8g2_hal";
+
+// Control byte plus one full row of tiles, the longest transfer u8g2 makes
+// for this panel. Longer transfers are split, repeating the control byte.
+#define U8G2_HAL_XFER_SIZE (1 + SSD1306_MAX_WIDTH)
+
+static SSD1306_t *hal_dev;
+static uint8_t xfer_buf[U8G2_HAL_XFER_SIZE];
+static size_t xfer_len;
+
+void u8g2_ssd1306_hal_init(SSD1306_t *dev)
+{
+    hal_dev = dev;
+}
+
+static void xfer_flush(void)
+{
+    if (xfer_len > 1)
+    {
+        i2c_transmit(hal_dev, xfer_buf, xfer_len);
+    }
+    xfer_len = 1; // keep the control byte for a continuation
+}
+
+// u8g2 hands over each transfer in pieces (control byte, then commands or
+// data). They are collected and sent as one i2c transaction at the end.
+uint8_t u8g2_ssd1306_i2c_byte_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+    switch (msg)
+    {
+    case U8X8_MSG_BYTE_INIT:
+        if (hal_dev == NULL)
+        {
+            ESP_LOGE(TAG, "u8g2_ssd1306_hal_init was not called");
+            return 0;
+        }
+        break;
+
+    case U8X8_MSG_BYTE_SET_DC:
+        break;
+
+    case U8X8_MSG_BYTE_START_TRANSFER:
+        xfer_len = 0;
+        break;
+
+    case U8X8_MSG_BYTE_SEND:
+    {
+        const uint8_t *data = arg_ptr;
+        size_t len = arg_int;
+        while (len > 0)
+        {
+            if (xfer_len == sizeof(xfer_buf))
+            {
+                xfer_flush();
+            }
+            size_t n = sizeof(xfer_buf) - xfer_len;
+            if (n > len)
+            {
+                n = len;
+            }
+            memcpy(&xfer_buf[xfer_len], data, n);
+            xfer_len += n;
+            data += n;
+            len -= n;
+        }
+        break;
+    }
+
+    case U8X8_MSG_BYTE_END_TRANSFER:
+        xfer_flush();
+        xfer_len = 0;
+        break;
+
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+// The panel has no reset line wired, only the delays are needed
+uint8_t u8g2_ssd1306_gpio_and_delay_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+    switch (msg)
+    {
+    case U8X8_MSG_DELAY_MILLI:
+        vTaskDelay(pdMS_TO_TICKS(arg_int) ? pdMS_TO_TICKS(arg_int) : 1);
+        break;
+    case U8X8_MSG_DELAY_10MICRO:
+        esp_rom_delay_us(10 * arg_int);
+        break;
+    case U8X8_MSG_DELAY_100NANO:
+        esp_rom_delay_us(1);
+        break;
+    default:
+        break;
+    }
+    return 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include "u8g2.h"
+#include "ssd1306.h"
+
+// u8g2 transport over the ssd1306 component's i2c device. The display (and
+// its bus) must be set up with i2c_master_init before u8g2_InitDisplay.
+void u8g2_ssd1306_hal_init(SSD1306_t *dev);
+
+uint8_t u8g2_ssd1306_i2c_byte_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
+uint8_t u8g2_ssd1306_gpio_and_delay_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
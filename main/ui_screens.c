@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include "nvs.h"
+#include "ui_screens.h"
+
+void ui_render_status(u8g2_t *u8g2, const status_screen_t *screen)
+{
+    static const uint8_t image_choice_bullet_off_bits[] = {0xe0, 0x03, 0x38, 0x0e, 0x0c, 0x18, 0x06, 0x30, 0x02, 0x20, 0x03, 0x60, 0x01, 0x40, 0x01, 0x40, 0x01, 0x40, 0x03, 0x60, 0x02, 0x20, 0x06, 0x30, 0x0c, 0x18, 0x38, 0x0e, 0xe0, 0x03, 0x00, 0x00};
+    static const uint8_t image_choice_bullet_on_bits[] = {0xe0, 0x03, 0x38, 0x0e, 0xcc, 0x19, 0xf6, 0x37, 0xfa, 0x2f, 0xfb, 0x6f, 0xfd, 0x5f, 0xfd, 0x5f, 0xfd, 0x5f, 0xfb, 0x6f, 0xfa, 0x2f, 0xf6, 0x37, 0xcc, 0x19, 0x38, 0x0e, 0xe0, 0x03, 0x00, 0x00};
+    static const uint8_t image_Hum_arrow_bits[] = {0x80, 0xff, 0xff, 0x7f, 0x40, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00};
+    static const uint8_t image_Temp_arrow_bits[] = {0xff, 0xff, 0x7f};
+    static const uint8_t image_weather_humidity_white_bits[] = {0x00, 0x00, 0x04, 0x00, 0x00, 0x02, 0x00, 0x00, 0x01, 0x00, 0x80, 0x00, 0x00, 0x40, 0x00, 0x00, 0x20, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x20, 0x00, 0x00, 0x30, 0x00, 0x00, 0x50, 0x00, 0x00, 0x48, 0x00, 0x00, 0x88, 0x00, 0x00, 0x04, 0x01, 0x00, 0x04, 0x01, 0x00, 0x82, 0x02, 0x00, 0x02, 0x03, 0x00, 0x01, 0x05, 0x00, 0x01, 0x04, 0x00, 0x02, 0x02, 0x00, 0x02, 0x02, 0x00, 0x0c, 0x01, 0x00, 0xf0, 0x00, 0x00};
+    static const uint8_t image_weather_temperature_bits[] = {0x38, 0x00, 0x44, 0x40, 0xd4, 0xa0, 0x54, 0x40, 0xd4, 0x1c, 0x54, 0x06, 0xd4, 0x02, 0x54, 0x02, 0x54, 0x06, 0x92, 0x1c, 0x39, 0x01, 0x75, 0x01, 0x7d, 0x01, 0x39, 0x01, 0x82, 0x00, 0x7c, 0x00};
+
+    u8g2_SetBitmapMode(u8g2, 1);
+    u8g2_SetFontMode(u8g2, 1);
+
+    // Humidity
+    u8g2_SetFont(u8g2, u8g2_font_profont11_tr);
+    u8g2_DrawStr(u8g2, 19, 8, screen->hum_line);
+
+    // Temp arrow
+    u8g2_DrawXBM(u8g2, 19, 9, 23, 1, image_Temp_arrow_bits);
+
+    // weather_temperature
+    u8g2_DrawXBM(u8g2, 0, 0, 16, 16, image_weather_temperature_bits);
+
+    // weather_humidity_white
+    u8g2_DrawXBM(u8g2, 0, 9, 19, 27, image_weather_humidity_white_bits);
+
+    // Hum arrow
+    u8g2_DrawXBM(u8g2, 11, 29, 31, 7, image_Hum_arrow_bits);
+
+    // Layer 5
+    u8g2_DrawStr(u8g2, 18, 27, screen->temp_line);
+
+    u8g2_DrawXBM(u8g2, 56, 16, 15, 16, screen->state_icon);
+
+    // Layer 11
+    u8g2_SetFont(u8g2, u8g2_font_profont10_tr);
+    u8g2_DrawStr(u8g2, 42, 39, screen->timer_line);
+
+    if (!screen->fan_on)
+    {
+        // choice_bullet_off
+        u8g2_DrawXBM(u8g2, 57, 0, 15, 16, image_choice_bullet_off_bits);
+    }
+    else
+    {
+        // choice_bullet_on
+        u8g2_DrawXBM(u8g2, 57, 0, 15, 16, image_choice_bullet_on_bits);
+    }
+}
+
+void ui_render_log(u8g2_t *u8g2, const log_screen_t *screen)
+{
+    u8g2_SetFont(u8g2, u8g2_font_profont10_tr);
+
+    if (screen->error)
+    {
+        u8g2_DrawStr(u8g2, 0, 10, "Log: NVS error");
+        return;
+    }
+
+    for (int i = 0; i < screen->shown; i++)
+    {
+        int y = 8 + i * 8;
+        u8g2_DrawStr(u8g2, 0, y, screen->lines[i]);
+    }
+
+    // Draw pagination info in the last line
+    u8g2_DrawStr(u8g2, 0, 8 + MAX_LOG_LINES * 8, screen->footer);
+}
+
+void ui_render_loading(u8g2_t *u8g2)
+{
+    u8g2_SetFont(u8g2, u8g2_font_profont11_tr);
+    u8g2_DrawStr(u8g2, 0, 8, "Loading...");
+}
+
+int ui_load_log_screen(log_screen_t *screen, int page_index)
+{
+    memset(screen, 0, sizeof(*screen));
+
+    nvs_handle_t handle;
+    if (nvs_open("fsm_log", NVS_READONLY, &handle) != ESP_OK)
+    {
+        screen->error = true;
+        return -1;
+    }
+
+    uint32_t index = 0;
+    nvs_get_u32(handle, "log_index", &index);
+
+    // Calculate how many logs we actually have
+    int entries_found = 0;
+    for (int i = 0; i < MAX_LOG_ENTRIES; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "entry_%d", i);
+        size_t len = 0;
+        if (nvs_get_str(handle, key, NULL, &len) == ESP_OK && len > 1)
+            entries_found++;
+    }
+
+    int total_pages = (entries_found + MAX_LOG_LINES - 1) / MAX_LOG_LINES;
+
+    // Get logs from newest to oldest
+    int start = entries_found - 1 - (page_index * MAX_LOG_LINES);
+
+    for (int i = start; i >= 0 && screen->shown < MAX_LOG_LINES; i--)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "entry_%d", i);
+
+        size_t len = sizeof(screen->lines[0]);
+        if (nvs_get_str(handle, key, screen->lines[screen->shown], &len) == ESP_OK)
+        {
+            screen->shown++;
+        }
+    }
+
+    snprintf(screen->footer, sizeof(screen->footer), "[%d / %d]", page_index + 1, total_pages);
+
+    nvs_close(handle);
+    return total_pages;
+}
+
+void ui_send_changed_tiles(u8g2_t *u8g2, const uint8_t *frame, uint8_t *shown, bool shown_valid)
+{
+    u8x8_t *u8x8 = u8g2_GetU8x8(u8g2);
+    int tile_width = u8g2_GetBufferTileWidth(u8g2);
+    int tile_height = u8g2_GetBufferTileHeight(u8g2);
+    int row_len = tile_width * 8;
+
+    for (int ty = 0; ty < tile_height; ty++)
+    {
+        const uint8_t *row = frame + ty * row_len;
+        uint8_t *prev = shown + ty * row_len;
+        int first = -1;
+        int last = -1;
+
+        for (int tx = 0; tx < tile_width; tx++)
+        {
+            if (!shown_valid || memcmp(row + tx * 8, prev + tx * 8, 8) != 0)
+            {
+                if (first < 0)
+                    first = tx;
+                last = tx;
+            }
+        }
+
+        if (first < 0)
+            continue;
+
+        // u8x8_DrawTile takes a non-const pointer but only reads the tiles
+        u8x8_DrawTile(u8x8, first, ty, last - first + 1, (uint8_t *)row + first * 8);
+        memcpy(prev + first * 8, row + first * 8, (last - first + 1) * 8);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "u8g2.h"
+#include "bus_budget.h"
+
+// The UI's screens, drawn into a u8g2 buffer. Drawing and loading only:
+// main.c owns the u8g2 instance, the frame clock and the flush task, the
+// host tests (test/host) render the same screens into the virtual panel.
+
+// The 0.42" panel is driven at its native 72x40, u8g2 applies the GRAM
+// column offset itself, so the buffer holds only the visible window.
+#define DISPLAY_WIDTH 72
+#define DISPLAY_HEIGHT 40
+
+#define MAX_LOG_LINES 4
+#define MAX_LOG_ENTRIES 50
+
+// Any screen may change every row (state change, next log page)
+#define UI_FRAME_BUDGET_BYTES BUS_BUDGET_ROWS(DISPLAY_HEIGHT / 8, DISPLAY_WIDTH)
+
+typedef struct
+{
+    const char *hum_line;
+    const char *temp_line;
+    const char *timer_line;
+    const uint8_t *state_icon;
+    bool fan_on;
+} status_screen_t;
+
+typedef struct
+{
+    bool error;
+    int shown;
+    char lines[MAX_LOG_LINES][64];
+    char footer[32];
+} log_screen_t;
+
+void ui_render_status(u8g2_t *u8g2, const status_screen_t *screen);
+void ui_render_log(u8g2_t *u8g2, const log_screen_t *screen);
+void ui_render_loading(u8g2_t *u8g2);
+
+// Page page_index of the FSM log in NVS, newest first. Returns the number of
+// pages, or -1 when NVS can't be read (screen->error is set then).
+int ui_load_log_screen(log_screen_t *screen, int page_index);
+
+// Send the 8x8 tiles of a full u8g2 frame that differ from shown, one
+// transfer per tile row, and copy them into shown. Everything is sent when
+// shown_valid is false.
+void ui_send_changed_tiles(u8g2_t *u8g2, const uint8_t *frame, uint8_t *shown, bool shown_valid);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+#include "bus_budget.h"
+#include "ssd1306.h"
+#include "test.h"
+
+// Traffic of one operation against its budget. The virtual panel decodes
+// what the transport counted, both have to agree.
+static inline void check_budget(SSD1306_t *dev, const bus_budget_t *budget)
+{
+    ssd1306_bus_stats_t bus = ssd1306_take_bus_stats(dev);
+    ssd1306_virtual_stats_t panel = ssd1306_virtual_take_stats(dev);
+
+    printf("{\"budget\":\"%s\",\"bytes\":%lu,\"max_bytes\":%lu,\"transactions\":%lu,\"wire_us\":%llu}\n",
+           budget->name, (unsigned long)bus.bytes, (unsigned long)budget->max_bytes,
+           (unsigned long)bus.transactions, (unsigned long long)(bus.wire_ns / 1000));
+    CHECK_INT(panel.bytes, bus.bytes);
+    CHECK_INT(panel.transactions, bus.transactions);
+    if (bus.bytes > budget->max_bytes)
+    {
+        fprintf(stderr, "Bus budget exceeded: %s sent %lu bytes, budget %lu\n", budget->name,
+                (unsigned long)bus.bytes, (unsigned long)budget->max_bytes);
+        test_failures++;
+    }
+}
+
+static inline void reset_stats(SSD1306_t *dev)
+{
+    ssd1306_take_bus_stats(dev);
+    ssd1306_virtual_take_stats(dev);
+}
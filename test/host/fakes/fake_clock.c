@@ -0,0 +1,64 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_rtc_time.h"
+#include "esp_rom_sys.h"
+#include "fakes.h"
+
+// Virtual time: nothing moves unless a test or a delay advances it, so
+// timeouts of minutes or hours run instantly and deterministically
+static int64_t clock_us; // since the last reboot
+static uint64_t rtc_us;  // since the last power-on
+
+void fake_clock_advance_us(int64_t us)
+{
+    clock_us += us;
+    rtc_us += us;
+}
+
+int64_t fake_clock_now_us(void)
+{
+    return clock_us;
+}
+
+// Called by fake_reboot
+void fake_clock_reboot(bool power_lost)
+{
+    clock_us = 0;
+    if (power_lost)
+        rtc_us = 0;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return clock_us;
+}
+
+uint64_t esp_rtc_get_time_us(void)
+{
+    return rtc_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    fake_clock_advance_us(us);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(clock_us / (portTICK_PERIOD_MS * 1000));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    fake_clock_advance_us((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    TickType_t wake = *previous_wake + period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0)
+        vTaskDelay(wake - now);
+    *previous_wake = wake;
+}
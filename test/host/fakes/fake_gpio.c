@@ -0,0 +1,48 @@
+#include "driver/gpio.h"
+#include "fakes.h"
+
+static int levels[GPIO_NUM_MAX];
+static int changes[GPIO_NUM_MAX];
+static bool level_set[GPIO_NUM_MAX];
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio)
+{
+    return (gpio >= 0 && gpio < GPIO_NUM_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode)
+{
+    return (gpio >= 0 && gpio < GPIO_NUM_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    if (!level_set[gpio] || levels[gpio] != (int)(level != 0))
+        changes[gpio]++;
+    levels[gpio] = level != 0;
+    level_set[gpio] = true;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX)
+        return 0;
+    return levels[gpio];
+}
+
+int fake_gpio_level(int gpio)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX || !level_set[gpio])
+        return -1;
+    return levels[gpio];
+}
+
+int fake_gpio_level_changes(int gpio)
+{
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX)
+        return 0;
+    return changes[gpio];
+}
@@ -0,0 +1,136 @@
+#include <string.h>
+#include "driver/i2c_master.h"
+#include "fakes.h"
+
+#define FAKE_I2C_DEVICES 4
+#define FAKE_I2C_SCRIPT 16
+#define FAKE_I2C_MAX_XFER 64
+
+typedef struct
+{
+    uint8_t data[FAKE_I2C_MAX_XFER];
+    size_t len;
+    esp_err_t err;
+} fake_i2c_response_t;
+
+typedef struct
+{
+    bool used;
+    uint16_t address;
+    int writes;
+    uint8_t last_write[FAKE_I2C_MAX_XFER];
+    size_t last_write_len;
+    esp_err_t write_err;
+    fake_i2c_response_t script[FAKE_I2C_SCRIPT];
+    int script_head;
+    int script_len;
+} fake_i2c_device_t;
+
+static fake_i2c_device_t devices[FAKE_I2C_DEVICES];
+
+static fake_i2c_device_t *device_at(uint16_t address, bool create)
+{
+    for (int i = 0; i < FAKE_I2C_DEVICES; i++)
+    {
+        if (devices[i].used && devices[i].address == address)
+            return &devices[i];
+    }
+    if (!create)
+        return NULL;
+    for (int i = 0; i < FAKE_I2C_DEVICES; i++)
+    {
+        if (!devices[i].used)
+        {
+            devices[i].used = true;
+            devices[i].address = address;
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+void fake_i2c_reset(void)
+{
+    memset(devices, 0, sizeof(devices));
+}
+
+void fake_i2c_script_read(uint16_t address, const uint8_t *data, size_t len, esp_err_t err)
+{
+    fake_i2c_device_t *dev = device_at(address, true);
+    if (dev == NULL || dev->script_len == FAKE_I2C_SCRIPT || len > FAKE_I2C_MAX_XFER)
+        abort();
+    fake_i2c_response_t *r = &dev->script[(dev->script_head + dev->script_len++) % FAKE_I2C_SCRIPT];
+    memcpy(r->data, data, len);
+    r->len = len;
+    r->err = err;
+}
+
+int fake_i2c_write_count(uint16_t address)
+{
+    fake_i2c_device_t *dev = device_at(address, false);
+    return dev ? dev->writes : 0;
+}
+
+size_t fake_i2c_last_write(uint16_t address, uint8_t *buf, size_t len)
+{
+    fake_i2c_device_t *dev = device_at(address, false);
+    if (dev == NULL)
+        return 0;
+    if (len > dev->last_write_len)
+        len = dev->last_write_len;
+    memcpy(buf, dev->last_write, len);
+    return dev->last_write_len;
+}
+
+void fake_i2c_fail_writes(uint16_t address, esp_err_t err)
+{
+    fake_i2c_device_t *dev = device_at(address, true);
+    if (dev != NULL)
+        dev->write_err = err;
+}
+
+// The handle is the device record
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *config,
+                                    i2c_master_dev_handle_t *handle)
+{
+    fake_i2c_device_t *dev = device_at(config->device_address, true);
+    if (dev == NULL)
+        return ESP_ERR_NO_MEM;
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t handle, const uint8_t *data, size_t len, int timeout_ms)
+{
+    fake_i2c_device_t *dev = handle;
+    if (dev == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (dev->write_err != ESP_OK)
+        return dev->write_err;
+    dev->writes++;
+    dev->last_write_len = len < FAKE_I2C_MAX_XFER ? len : FAKE_I2C_MAX_XFER;
+    memcpy(dev->last_write, data, dev->last_write_len);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t handle, uint8_t *data, size_t len, int timeout_ms)
+{
+    fake_i2c_device_t *dev = handle;
+    if (dev == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (dev->script_len == 0)
+        return ESP_ERR_TIMEOUT;
+    fake_i2c_response_t *r = &dev->script[dev->script_head];
+    dev->script_head = (dev->script_head + 1) % FAKE_I2C_SCRIPT;
+    dev->script_len--;
+    if (r->err != ESP_OK)
+        return r->err;
+    memset(data, 0xFF, len); // a short response reads as an idle bus
+    memcpy(data, r->data, r->len < len ? r->len : len);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus, uint16_t address, int timeout_ms)
+{
+    return device_at(address, false) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,232 @@
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "fakes.h"
+
+// A flat table of (namespace, key) entries. Writes are visible at once,
+// commits are only counted.
+#define FAKE_NVS_ENTRIES 128
+#define FAKE_NVS_VALUE_MAX 128
+#define FAKE_NVS_NAMESPACES 8
+#define FAKE_NVS_HANDLES 8
+
+typedef enum
+{
+    ENTRY_FREE,
+    ENTRY_STR,
+    ENTRY_U32,
+    ENTRY_BLOB,
+} entry_type_t;
+
+typedef struct
+{
+    entry_type_t type;
+    int ns;
+    char key[16]; // NVS keys are at most 15 characters
+    uint8_t value[FAKE_NVS_VALUE_MAX];
+    size_t len;
+} entry_t;
+
+static entry_t entries[FAKE_NVS_ENTRIES];
+static char namespaces[FAKE_NVS_NAMESPACES][16];
+static struct
+{
+    bool open;
+    int ns;
+    bool writable;
+} handles[FAKE_NVS_HANDLES];
+static int commits;
+
+void fake_nvs_erase_all(void)
+{
+    memset(entries, 0, sizeof(entries));
+    memset(namespaces, 0, sizeof(namespaces));
+    memset(handles, 0, sizeof(handles));
+    commits = 0;
+}
+
+int fake_nvs_commits(void)
+{
+    return commits;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    fake_nvs_erase_all();
+    return ESP_OK;
+}
+
+static int namespace_index(const char *name, bool create)
+{
+    for (int i = 0; i < FAKE_NVS_NAMESPACES; i++)
+    {
+        if (namespaces[i][0] != '\0' && strcmp(namespaces[i], name) == 0)
+            return i;
+    }
+    if (!create)
+        return -1;
+    for (int i = 0; i < FAKE_NVS_NAMESPACES; i++)
+    {
+        if (namespaces[i][0] == '\0')
+        {
+            strncpy(namespaces[i], name, sizeof(namespaces[i]) - 1);
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Handles are 1-based so 0 is never valid
+static int handle_ns(nvs_handle_t handle, bool write)
+{
+    if (handle == 0 || handle > FAKE_NVS_HANDLES || !handles[handle - 1].open)
+        return -1;
+    if (write && !handles[handle - 1].writable)
+        return -1;
+    return handles[handle - 1].ns;
+}
+
+static entry_t *find(int ns, const char *key)
+{
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++)
+    {
+        if (entries[i].type != ENTRY_FREE && entries[i].ns == ns && strcmp(entries[i].key, key) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static esp_err_t store(nvs_handle_t handle, const char *key, entry_type_t type, const void *value, size_t len)
+{
+    int ns = handle_ns(handle, true);
+    if (ns < 0)
+        return ESP_ERR_INVALID_ARG;
+    if (strlen(key) >= sizeof(entries[0].key) || len > FAKE_NVS_VALUE_MAX)
+        return ESP_ERR_INVALID_ARG;
+    entry_t *e = find(ns, key);
+    for (int i = 0; e == NULL && i < FAKE_NVS_ENTRIES; i++)
+    {
+        if (entries[i].type == ENTRY_FREE)
+            e = &entries[i];
+    }
+    if (e == NULL)
+        return ESP_ERR_NO_MEM;
+    e->type = type;
+    e->ns = ns;
+    strcpy(e->key, key);
+    memcpy(e->value, value, len);
+    e->len = len;
+    return ESP_OK;
+}
+
+static esp_err_t load(nvs_handle_t handle, const char *key, entry_type_t type, entry_t **out)
+{
+    int ns = handle_ns(handle, false);
+    if (ns < 0)
+        return ESP_ERR_INVALID_ARG;
+    entry_t *e = find(ns, key);
+    if (e == NULL || e->type != type)
+        return ESP_ERR_NVS_NOT_FOUND;
+    *out = e;
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+    int ns = namespace_index(name, mode == NVS_READWRITE);
+    if (ns < 0)
+        return ESP_ERR_NVS_NOT_FOUND;
+    for (int i = 0; i < FAKE_NVS_HANDLES; i++)
+    {
+        if (!handles[i].open)
+        {
+            handles[i].open = true;
+            handles[i].ns = ns;
+            handles[i].writable = (mode == NVS_READWRITE);
+            *handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    if (handle > 0 && handle <= FAKE_NVS_HANDLES)
+        handles[handle - 1].open = false;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    if (handle_ns(handle, true) < 0)
+        return ESP_ERR_INVALID_ARG;
+    commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return store(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+// Same protocol as IDF: a NULL buffer asks for the length
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    entry_t *e;
+    esp_err_t err = load(handle, key, ENTRY_STR, &e);
+    if (err != ESP_OK)
+        return err;
+    if (out_value == NULL)
+    {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, e->value, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return store(handle, key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    entry_t *e;
+    esp_err_t err = load(handle, key, ENTRY_U32, &e);
+    if (err != ESP_OK)
+        return err;
+    memcpy(out_value, e->value, sizeof(*out_value));
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return store(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    entry_t *e;
+    esp_err_t err = load(handle, key, ENTRY_BLOB, &e);
+    if (err != ESP_OK)
+        return err;
+    if (out_value == NULL)
+    {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, e->value, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
@@ -0,0 +1,152 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "fakes.h"
+
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+static struct timeval wall_clock;
+static bool wall_clock_valid;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH:
+        return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:
+        return "ESP_ERR_UNKNOWN";
+    }
+}
+
+void fake_log(char level, const char *tag, const char *fmt, ...)
+{
+    if (level == 'I' && getenv("FAKE_LOG_QUIET") != NULL)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c (%s) ", level, tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// ----- Reset -----
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return reset_reason;
+}
+
+void fake_reboot(esp_reset_reason_t reason)
+{
+    reset_reason = reason;
+    fake_clock_reboot(reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT);
+    wall_clock_valid = false;
+}
+
+int fake_settimeofday(const struct timeval *tv, const void *tz)
+{
+    wall_clock = *tv;
+    wall_clock_valid = true;
+    return 0;
+}
+
+bool fake_wall_clock_set(struct timeval *tv)
+{
+    if (wall_clock_valid && tv != NULL)
+        *tv = wall_clock;
+    return wall_clock_valid;
+}
+
+// Same reflected polynomial as the ROM function
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// ----- FreeRTOS -----
+// Single thread: mutexes are always free, tasks are never started
+
+struct fake_semaphore
+{
+    int taken;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(struct fake_semaphore));
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    if (semaphore->taken)
+    {
+        fprintf(stderr, "xSemaphoreTake: mutex already taken, would deadlock\n");
+        abort();
+    }
+    semaphore->taken = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->taken = 0;
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle)
+{
+    ESP_LOGW("fake", "xTaskCreate(%s): no tasks on the host", name);
+    return pdFAIL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return pdPASS;
+}
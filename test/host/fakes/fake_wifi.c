@@ -0,0 +1,144 @@
+#include <stddef.h>
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_sntp.h"
+#include "fakes.h"
+
+const esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+const esp_event_base_t IP_EVENT = "IP_EVENT";
+
+#define FAKE_EVENT_HANDLERS 4
+
+static struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handlers[FAKE_EVENT_HANDLERS];
+static int handler_count;
+
+static sntp_sync_time_cb_t sntp_callback;
+static bool sntp_running;
+static int64_t sntp_server_epoch_us = -1;
+
+static void post_event(esp_event_base_t base, int32_t id)
+{
+    for (int i = 0; i < handler_count; i++)
+    {
+        if (handlers[i].base == base && (handlers[i].id == ESP_EVENT_ANY_ID || handlers[i].id == id))
+            handlers[i].handler(handlers[i].arg, base, id, NULL);
+    }
+}
+
+void fake_wifi_got_ip(void)
+{
+    post_event(IP_EVENT, IP_EVENT_STA_GOT_IP);
+}
+
+void fake_sntp_set_server_time(int64_t epoch_us)
+{
+    sntp_server_epoch_us = epoch_us;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    handler_count = 0; // a new boot registers its handlers again
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance)
+{
+    if (handler_count == FAKE_EVENT_HANDLERS)
+        return ESP_ERR_NO_MEM;
+    handlers[handler_count].base = base;
+    handlers[handler_count].id = id;
+    handlers[handler_count].handler = handler;
+    handlers[handler_count].arg = arg;
+    handler_count++;
+    if (instance != NULL)
+        *instance = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return NULL;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    return ESP_OK;
+}
+
+// The connection itself is not simulated, tests post the IP event
+esp_err_t esp_wifi_start(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+void esp_sntp_stop(void)
+{
+    sntp_running = false;
+}
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t mode)
+{
+}
+
+void esp_sntp_setservername(int idx, const char *server)
+{
+}
+
+void esp_sntp_init(void)
+{
+    sntp_running = true;
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+    sntp_callback = callback;
+}
+
+// The first poll after start gets the answer, if the server is reachable
+sntp_sync_status_t sntp_get_sync_status(void)
+{
+    if (!sntp_running || sntp_server_epoch_us < 0)
+        return SNTP_SYNC_STATUS_RESET;
+    struct timeval tv = {
+        .tv_sec = sntp_server_epoch_us / 1000000,
+        .tv_usec = sntp_server_epoch_us % 1000000,
+    };
+    fake_settimeofday(&tv, NULL);
+    sntp_running = false; // one sync per start, like a poll interval of an hour
+    if (sntp_callback != NULL)
+        sntp_callback(&tv);
+    return SNTP_SYNC_STATUS_COMPLETED;
+}
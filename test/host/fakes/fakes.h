@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "esp_err.h"
+#include "esp_system.h"
+
+// Control side of the in-memory ESP-IDF fakes the host tests link against.
+// The firmware sources only see the IDF API in test/host/include.
+
+// ----- Clock (fake_clock.c) -----
+// esp_timer, the FreeRTOS tick and the RTC timer all run off one virtual
+// clock that only moves when a test or a delay advances it.
+void fake_clock_advance_us(int64_t us);
+int64_t fake_clock_now_us(void); // esp_timer_get_time
+void fake_clock_reboot(bool power_lost); // fake_reboot only
+
+// ----- Reboot (fake_system.c) -----
+// esp_timer restarts from 0; the RTC timer and RTC_NOINIT statics survive
+// unless the reason is a power-on or brownout. NVS always survives.
+void fake_reboot(esp_reset_reason_t reason);
+
+// Last value passed to settimeofday (time_sync_wifi.c is built with
+// settimeofday renamed, the host clock is never touched)
+bool fake_wall_clock_set(struct timeval *tv);
+int fake_settimeofday(const struct timeval *tv, const void *tz);
+
+// ----- I2C (fake_i2c.c) -----
+// Every transmit is recorded per device address, receives are answered from
+// a script of queued responses; an empty script times out.
+void fake_i2c_reset(void);
+void fake_i2c_script_read(uint16_t address, const uint8_t *data, size_t len, esp_err_t err);
+int fake_i2c_write_count(uint16_t address);
+size_t fake_i2c_last_write(uint16_t address, uint8_t *buf, size_t len); // bytes of the last transmit
+void fake_i2c_fail_writes(uint16_t address, esp_err_t err); // ESP_OK to stop failing
+
+// ----- GPIO (fake_gpio.c) -----
+int fake_gpio_level(int gpio);       // last level set, -1 if never set
+int fake_gpio_level_changes(int gpio); // gpio_set_level calls that changed the level
+
+// ----- NVS (fake_nvs.c) -----
+void fake_nvs_erase_all(void);
+int fake_nvs_commits(void);
+
+// ----- Wi-Fi and SNTP (fake_wifi.c) -----
+// An IP_EVENT_STA_GOT_IP makes time_sync_wifi start SNTP. With a server
+// epoch set the first status poll delivers the time, without one every poll
+// stays pending.
+void fake_wifi_got_ip(void);
+void fake_sntp_set_server_time(int64_t epoch_us); // < 0: unreachable
@@ -0,0 +1,50 @@
+#include <sched.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_rtc_time.h"
+#include "esp_rom_sys.h"
+#include "fakes.h"
+
+// Real time for the microbenchmarks: esp_timer is the host's monotonic
+// clock. Delays only yield, the tick count is derived from the clock.
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+uint64_t esp_rtc_get_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end)
+        ;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (portTICK_PERIOD_MS * 1000));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sched_yield();
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    *previous_wake += period;
+    sched_yield();
+}
+
+void fake_clock_reboot(bool power_lost)
+{
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Same handle types as the ssd1306 virtual backend declares, so both
+// headers can be included together
+typedef int i2c_port_t;
+typedef void *i2c_master_bus_handle_t;
+typedef void *i2c_master_dev_handle_t;
+
+typedef enum
+{
+    I2C_ADDR_BIT_LEN_7,
+    I2C_ADDR_BIT_LEN_10,
+} i2c_addr_bit_len_t;
+
+typedef struct
+{
+    i2c_addr_bit_len_t dev_addr_length;
+    uint16_t device_address;
+    uint32_t scl_speed_hz;
+} i2c_device_config_t;
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *config,
+                                    i2c_master_dev_handle_t *handle);
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t handle, const uint8_t *data, size_t len, int timeout_ms);
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t handle, uint8_t *data, size_t len, int timeout_ms);
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus, uint16_t address, int timeout_ms);
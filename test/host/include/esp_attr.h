@@ -0,0 +1,7 @@
+#pragma once
+
+// RTC_NOINIT variables are ordinary statics on the host: they keep their
+// value across fake_reboot, like RTC memory across a soft reset
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
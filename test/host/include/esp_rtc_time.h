@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Keeps counting across fake_reboot with a warm reset reason
+uint64_t esp_rtc_get_time_us(void);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <sys/time.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    SNTP_OPMODE_POLL,
+    SNTP_OPMODE_LISTENONLY,
+} esp_sntp_operatingmode_t;
+
+typedef enum
+{
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void esp_sntp_stop(void);
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t mode);
+void esp_sntp_setservername(int idx, const char *server);
+void esp_sntp_init(void);
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+sntp_sync_status_t sntp_get_sync_status(void); // COMPLETED is reported once
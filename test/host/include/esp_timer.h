@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fake clock (fakes/fake_clock.c) or the host's monotonic clock
+// (fakes/host_clock.c), depending on what the executable links
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+enum
+{
+    WIFI_EVENT_STA_START = 2,
+    WIFI_EVENT_STA_CONNECTED = 4,
+    WIFI_EVENT_STA_DISCONNECTED = 5,
+};
+
+enum
+{
+    IP_EVENT_STA_GOT_IP = 0,
+};
+
+typedef struct
+{
+    int magic;
+} wifi_init_config_t;
+#define WIFI_INIT_CONFIG_DEFAULT() {0}
+
+typedef enum
+{
+    WIFI_AUTH_OPEN,
+    WIFI_AUTH_WPA2_PSK = 3,
+} wifi_auth_mode_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    struct
+    {
+        wifi_auth_mode_t authmode;
+    } threshold;
+    uint16_t listen_interval;
+} wifi_sta_config_t;
+
+typedef union
+{
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef enum
+{
+    WIFI_MODE_NULL,
+    WIFI_MODE_STA,
+} wifi_mode_t;
+
+typedef enum
+{
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef enum
+{
+    WIFI_IF_STA,
+} wifi_interface_t;
+#define ESP_IF_WIFI_STA WIFI_IF_STA
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host build of the firmware sources: the panel is the ssd1306 virtual
+// backend and its traffic is counted. Everything else keeps the device
+// defaults from /sdkconfig.
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_I2C_INTERFACE 1
+#define CONFIG_SSD1306_72x40 1
+#define CONFIG_OFFSETX 28
+#define CONFIG_SSD1306_VIRTUAL 1
+#define CONFIG_SSD1306_BUS_STATS 1
+#define CONFIG_SCL_GPIO 6
+#define CONFIG_SDA_GPIO 5
+#define CONFIG_RESET_GPIO 4
+#define CONFIG_I2C_PORT_0 1
+#define CONFIG_FREERTOS_HZ 100
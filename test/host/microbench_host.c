@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "fsm.h"
+#include "microbench.h"
+
+// The microbenchmarks of CONFIG_MICROBENCH on the host: same JSON lines,
+// timed with the host's monotonic clock, the panel is the virtual one.
+// Compare runs on the same machine only, not with the device numbers.
+int main(void)
+{
+    static SSD1306_t dev;
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, 72, 40);
+    fsm_init();
+    microbench_run(&dev);
+    return 0;
+}
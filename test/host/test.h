@@ -0,0 +1,67 @@
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Every test file is its own executable: CHECK records the failure and keeps
+// going, TEST_EXIT makes ctest see it
+static int test_failures;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_INT(actual, expected)                                         \
+    do                                                                      \
+    {                                                                       \
+        long long a_ = (long long)(actual), e_ = (long long)(expected);     \
+        if (a_ != e_)                                                       \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                             \
+    do                                                                      \
+    {                                                                       \
+        double a_ = (actual), e_ = (expected);                              \
+        if (fabs(a_ - e_) > (tolerance))                                    \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: %s == %g, expected %g\n", __FILE__, __LINE__, #actual, a_, e_); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+// Each test runs in a child process so it starts from a freshly loaded image:
+// statics of the code under test don't leak from one test into the next
+#define RUN_TEST(fn)                                                        \
+    do                                                                      \
+    {                                                                       \
+        fflush(stdout);                                                     \
+        pid_t pid_ = fork();                                                \
+        if (pid_ == 0)                                                      \
+        {                                                                   \
+            test_failures = 0;                                              \
+            fn();                                                           \
+            exit(test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);         \
+        }                                                                   \
+        int status_ = -1;                                                   \
+        waitpid(pid_, &status_, 0);                                         \
+        bool ok_ = pid_ > 0 && WIFEXITED(status_) && WEXITSTATUS(status_) == EXIT_SUCCESS; \
+        if (!ok_)                                                           \
+            test_failures++;                                                \
+        printf("%s %s\n", ok_ ? "PASS" : "FAIL", #fn);                     \
+    } while (0)
+
+#define TEST_EXIT() return test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE
@@ -0,0 +1,98 @@
+#include <string.h>
+#include "aht.h"
+#include "fakes.h"
+#include "test.h"
+
+#define AHT10_ADDRESS 0x38
+
+// Frames as the sensor sends them: status, 20 bits humidity, 20 bits temperature
+static void test_convert_known_frames(void)
+{
+    float t, h;
+
+    // Raw humidity 0x80000 (50 %), raw temperature 0x66666 (30 C)
+    const uint8_t mid[6] = {0x1C, 0x80, 0x00, 0x06, 0x66, 0x66};
+    aht_convert(mid, &t, &h);
+    CHECK_NEAR(h, 50.0, 0.001);
+    CHECK_NEAR(t, 30.0, 0.001);
+
+    const uint8_t zero[6] = {0x1C, 0x00, 0x00, 0x00, 0x00, 0x00};
+    aht_convert(zero, &t, &h);
+    CHECK_NEAR(h, 0.0, 0.001);
+    CHECK_NEAR(t, -50.0, 0.001);
+
+    const uint8_t full[6] = {0x1C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    aht_convert(full, &t, &h);
+    CHECK_NEAR(h, 100.0, 0.001);
+    CHECK_NEAR(t, 150.0, 0.001);
+
+    // The shared byte: high nibble ends humidity, low nibble starts temperature
+    const uint8_t shared[6] = {0x1C, 0xB3, 0x33, 0x35, 0x99, 0x9A};
+    aht_convert(shared, &t, &h);
+    CHECK_NEAR(h, 70.0, 0.001);
+    CHECK_NEAR(t, 20.0, 0.001);
+}
+
+static void test_init_trigger_fetch(void)
+{
+    uint8_t sent[8];
+    float t, h;
+
+    fake_i2c_reset();
+    CHECK_INT(aht_init(NULL), ESP_OK);
+    CHECK_INT(fake_i2c_write_count(AHT10_ADDRESS), 1);
+    CHECK_INT(fake_i2c_last_write(AHT10_ADDRESS, sent, sizeof(sent)), 3);
+    CHECK(memcmp(sent, (const uint8_t[]){0xBE, 0x08, 0x00}, 3) == 0);
+
+    const uint8_t frame[6] = {0x1C, 0xB3, 0x33, 0x35, 0x99, 0x9A};
+    fake_i2c_script_read(AHT10_ADDRESS, frame, sizeof(frame), ESP_OK);
+    CHECK_INT(aht_trigger(), ESP_OK);
+    CHECK_INT(fake_i2c_last_write(AHT10_ADDRESS, sent, sizeof(sent)), 3);
+    CHECK(memcmp(sent, (const uint8_t[]){0xAC, 0x33, 0x00}, 3) == 0);
+    CHECK_INT(aht_fetch(&t, &h), ESP_OK);
+    CHECK_NEAR(h, 70.0, 0.001);
+    CHECK_NEAR(t, 20.0, 0.001);
+}
+
+static void test_read_waits_for_the_measurement(void)
+{
+    float t, h;
+
+    fake_i2c_reset();
+    CHECK_INT(aht_init(NULL), ESP_OK);
+    const uint8_t frame[6] = {0x1C, 0x80, 0x00, 0x06, 0x66, 0x66};
+    fake_i2c_script_read(AHT10_ADDRESS, frame, sizeof(frame), ESP_OK);
+
+    int64_t before = fake_clock_now_us();
+    CHECK_INT(aht_read(&t, &h), ESP_OK);
+    CHECK(fake_clock_now_us() - before >= AHT_MEASURE_MS * 1000);
+    CHECK_NEAR(h, 50.0, 0.001);
+}
+
+static void test_bus_errors_are_returned(void)
+{
+    float t = -1, h = -1;
+
+    fake_i2c_reset();
+    CHECK_INT(aht_init(NULL), ESP_OK);
+
+    // Nothing scripted: the read times out and the outputs are untouched
+    CHECK_INT(aht_fetch(&t, &h), ESP_ERR_TIMEOUT);
+    CHECK_NEAR(t, -1.0, 0);
+    CHECK_NEAR(h, -1.0, 0);
+
+    fake_i2c_script_read(AHT10_ADDRESS, NULL, 0, ESP_FAIL);
+    CHECK_INT(aht_fetch(&t, &h), ESP_FAIL);
+
+    fake_i2c_fail_writes(AHT10_ADDRESS, ESP_ERR_TIMEOUT);
+    CHECK_INT(aht_read(&t, &h), ESP_ERR_TIMEOUT);
+}
+
+int main(void)
+{
+    RUN_TEST(test_convert_known_frames);
+    RUN_TEST(test_init_trigger_fetch);
+    RUN_TEST(test_read_waits_for_the_measurement);
+    RUN_TEST(test_bus_errors_are_returned);
+    TEST_EXIT();
+}
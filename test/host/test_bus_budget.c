@@ -0,0 +1,79 @@
+#include <string.h>
+#include "ssd1306.h"
+#include "bus_budget.h"
+#include "budget.h"
+#include "test.h"
+
+#define WIDTH 72
+#define HEIGHT 40
+
+static SSD1306_t dev;
+
+static void start(bool burst)
+{
+    memset(&dev, 0, sizeof(dev));
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, WIDTH, HEIGHT);
+    ssd1306_set_burst(&dev, burst);
+    ssd1306_clear_screen(&dev, false);
+    reset_stats(&dev);
+}
+
+// Same operations as the microbenchmark budgets (main/microbench.c)
+static void display_text_16_chars(bool burst)
+{
+    const bus_budget_t text = {"ssd1306_display_text 16 chars", BUS_BUDGET_TEXT_LINE(WIDTH)};
+
+    start(burst);
+    ssd1306_display_text(&dev, 0, "0123456789ABCDEF", 16, false);
+    check_budget(&dev, &text);
+
+    // Changing it to something else costs the same at most
+    ssd1306_display_text(&dev, 0, "FEDCBA9876543210", 16, true);
+    check_budget(&dev, &text);
+}
+
+static void fadeout(bool burst)
+{
+    const bus_budget_t fadeout = {"ssd1306_fadeout", BUS_BUDGET_FADEOUT(HEIGHT / 8, WIDTH)};
+
+    start(burst);
+    for (int page = 0; page < HEIGHT / 8; page++)
+        ssd1306_display_text(&dev, page, "0123456789ABCDEF", 16, true);
+    reset_stats(&dev);
+    ssd1306_fadeout(&dev);
+    check_budget(&dev, &fadeout);
+
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            CHECK(!ssd1306_virtual_pixel(&dev, x, y));
+}
+
+static void test_display_text_16_chars(void)
+{
+    display_text_16_chars(false);
+}
+
+static void test_display_text_16_chars_burst(void)
+{
+    display_text_16_chars(true);
+}
+
+static void test_fadeout(void)
+{
+    fadeout(false);
+}
+
+static void test_fadeout_burst(void)
+{
+    fadeout(true);
+}
+
+int main(void)
+{
+    RUN_TEST(test_display_text_16_chars);
+    RUN_TEST(test_display_text_16_chars_burst);
+    RUN_TEST(test_fadeout);
+    RUN_TEST(test_fadeout_burst);
+    TEST_EXIT();
+}
@@ -0,0 +1,227 @@
+#include <string.h>
+#include "fsm.h"
+#include "nvs.h"
+#include "fakes.h"
+#include "test.h"
+
+#define FAN_RELAY_GPIO 3 // active low
+#define MINUTES(x) ((x) * 60 * 1000000LL)
+
+// The FSM runs off its own injected clock, independent of esp_timer
+static int64_t now_us;
+
+static int64_t test_clock(void)
+{
+    return now_us;
+}
+
+static void at_minute(double minutes)
+{
+    now_us = (int64_t)(minutes * 60 * 1000000);
+}
+
+static void start(void)
+{
+    fake_nvs_erase_all();
+    fsm_set_clock(test_clock);
+    at_minute(0);
+    fsm_init();
+}
+
+static int log_entries(void)
+{
+    nvs_handle_t handle;
+    uint32_t index = 0;
+    if (nvs_open("fsm_log", NVS_READONLY, &handle) != ESP_OK)
+        return 0;
+    nvs_get_u32(handle, "log_index", &index);
+    nvs_close(handle);
+    return index;
+}
+
+static void test_init_turns_fan_off(void)
+{
+    start();
+    CHECK_INT(fsm_get_state(), IDLE);
+    CHECK(!fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 1);
+    CHECK_INT(log_entries(), 0); // "FSM initialized" is not logged right after boot
+}
+
+static void test_high_humidity_cools_then_waits(void)
+{
+    start();
+    at_minute(1);
+    fsm_update(65.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+
+    fsm_update(75.0f);
+    CHECK_INT(fsm_get_state(), COOLING);
+    CHECK(fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 0);
+
+    at_minute(10);
+    fsm_update(75.0f);
+    CHECK_INT(fsm_get_state(), COOLING);
+
+    // Humidity back below the threshold ends cooling early
+    fsm_update(60.0f);
+    CHECK_INT(fsm_get_state(), WAITING);
+    CHECK(!fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 1);
+    CHECK_INT(log_entries(), 2);
+}
+
+static void test_cooling_stops_after_30_minutes(void)
+{
+    start();
+    at_minute(1);
+    fsm_update(80.0f);
+    at_minute(31);
+    fsm_update(80.0f);
+    CHECK_INT(fsm_get_state(), COOLING);
+    at_minute(31.1);
+    fsm_update(80.0f);
+    CHECK_INT(fsm_get_state(), WAITING);
+}
+
+static void test_waiting_returns_to_idle_after_2_hours(void)
+{
+    start();
+    at_minute(1);
+    fsm_update(80.0f);
+    at_minute(2);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), WAITING);
+
+    // High humidity is ignored while waiting
+    at_minute(100);
+    fsm_update(90.0f);
+    CHECK_INT(fsm_get_state(), WAITING);
+    CHECK(!fsm_is_fan_on());
+
+    at_minute(122.1);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+    CHECK(!fsm_is_fan_on());
+}
+
+static void test_force_after_6_dry_hours(void)
+{
+    start();
+    at_minute(360);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+
+    at_minute(360.1);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), FORCE);
+    CHECK(fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 0);
+
+    at_minute(390.2);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+    CHECK(!fsm_is_fan_on());
+
+    // The 6 h count starts over from the end of the forced run
+    at_minute(700);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+}
+
+static void test_high_humidity_resets_force_timer(void)
+{
+    start();
+    at_minute(300);
+    fsm_update(50.0f);
+    at_minute(301);
+    fsm_update(80.0f); // COOLING
+    at_minute(302);
+    fsm_update(50.0f); // WAITING
+    at_minute(423);
+    fsm_update(50.0f); // IDLE
+    CHECK_INT(fsm_get_state(), IDLE);
+
+    at_minute(600);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+    at_minute(661.1);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), FORCE);
+}
+
+static void test_manual_override(void)
+{
+    start();
+    at_minute(5);
+    fsm_set_manual_override(true);
+    CHECK_INT(fsm_get_state(), COOLING);
+    CHECK(fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 0);
+
+    // A manual run ends like any other cooling run
+    at_minute(35.1);
+    fsm_update(80.0f);
+    CHECK_INT(fsm_get_state(), WAITING);
+
+    fsm_set_manual_override(false);
+    CHECK_INT(fsm_get_state(), IDLE);
+    CHECK(!fsm_is_fan_on());
+    CHECK_INT(fake_gpio_level(FAN_RELAY_GPIO), 1);
+
+    // Switching off restarts the 6 h count
+    at_minute(35.1 + 359.9);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), IDLE);
+    at_minute(35.2 + 360);
+    fsm_update(50.0f);
+    CHECK_INT(fsm_get_state(), FORCE);
+}
+
+static void test_display_lines(void)
+{
+    char fan[16], timer[16], state[16];
+
+    start();
+    at_minute(1);
+    fsm_update(80.0f);
+    at_minute(11.5);
+    fsm_get_display_lines(fan, timer, state);
+    CHECK(strcmp(fan, "FAN ON ") == 0);
+    CHECK(strcmp(timer, "19:30") == 0);
+    CHECK(strcmp(state, "COOLING") == 0);
+    CHECK(fsm_get_state_icon() != NULL);
+
+    at_minute(20);
+    fsm_update(50.0f);
+    at_minute(200);
+    fsm_get_display_lines(fan, timer, state);
+    CHECK(strcmp(fan, "FAN OFF") == 0);
+    CHECK(strcmp(timer, "00:00") == 0); // overdue, clamped
+    CHECK(strcmp(state, "WAIT   ") == 0);
+}
+
+static void test_log_line_without_wall_clock(void)
+{
+    char line[64];
+
+    start();
+    now_us = MINUTES(62) + 5 * 1000000LL;
+    fsm_format_log_line(line, sizeof(line), "COOLING", 71.25f);
+    CHECK(strcmp(line, "+01:02:05: COOLING [71.2%]") == 0 || strcmp(line, "+01:02:05: COOLING [71.3%]") == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_init_turns_fan_off);
+    RUN_TEST(test_high_humidity_cools_then_waits);
+    RUN_TEST(test_cooling_stops_after_30_minutes);
+    RUN_TEST(test_waiting_returns_to_idle_after_2_hours);
+    RUN_TEST(test_force_after_6_dry_hours);
+    RUN_TEST(test_high_humidity_resets_force_timer);
+    RUN_TEST(test_manual_override);
+    RUN_TEST(test_display_lines);
+    RUN_TEST(test_log_line_without_wall_clock);
+    TEST_EXIT();
+}
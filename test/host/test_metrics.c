@@ -0,0 +1,82 @@
+#include <string.h>
+#include "metrics.h"
+#include "test.h"
+
+static void test_histogram_fields(void)
+{
+    metric_snapshot_t s;
+
+    metrics_reset();
+    metrics_record(METRIC_AHT_READ_US, 0);
+    metrics_record(METRIC_AHT_READ_US, 5);
+    metrics_record(METRIC_AHT_READ_US, 1000);
+    CHECK(metrics_get(METRIC_AHT_READ_US, &s));
+    CHECK_INT(s.count, 3);
+    CHECK_INT(s.sum, 1005);
+    CHECK_INT(s.max, 1000);
+    CHECK_INT(s.buckets[0], 1);
+    CHECK_INT(s.buckets[3], 1);  // [4, 8)
+    CHECK_INT(s.buckets[10], 1); // [512, 1024)
+    CHECK_INT(metrics_percentile(&s, 50), 7);
+    CHECK_INT(metrics_percentile(&s, 99), 1023);
+}
+
+// The atomic path of a metric written by several tasks keeps the same fields
+static void test_shared_histogram(void)
+{
+    metric_snapshot_t s;
+
+    metrics_reset();
+    metrics_record(METRIC_NVS_WRITE_US, 300);
+    metrics_record(METRIC_NVS_WRITE_US, 100);
+    CHECK(metrics_get(METRIC_NVS_WRITE_US, &s));
+    CHECK_INT(s.count, 2);
+    CHECK_INT(s.sum, 400);
+    CHECK_INT(s.max, 300);
+    CHECK_INT(s.buckets[7] + s.buckets[9], 2);
+}
+
+static void test_counters_and_gauges(void)
+{
+    metric_snapshot_t s;
+
+    metrics_reset();
+    metrics_count(METRIC_AHT_READS, 2);
+    metrics_count(METRIC_AHT_READS, 3);
+    metrics_set(METRIC_HEAP_FREE, 1234);
+    metrics_set(METRIC_HEAP_FREE, -5);
+    CHECK(metrics_get(METRIC_AHT_READS, &s));
+    CHECK_INT(s.count, 5);
+    CHECK(metrics_get(METRIC_HEAP_FREE, &s));
+    CHECK_INT(s.value, -5);
+    CHECK(!metrics_get(METRIC_COUNT, &s));
+}
+
+static void test_format(void)
+{
+    char buf[2048];
+
+    metrics_reset();
+    metrics_count(METRIC_UI_FRAMES, 7);
+    metrics_record(METRIC_FSM_UPDATE_US, 10);
+    metrics_record(METRIC_FSM_UPDATE_US, 30);
+    size_t len = metrics_format(buf, sizeof(buf));
+    CHECK_INT(len, strlen(buf));
+    CHECK(strstr(buf, "ui.frames 7\n") != NULL);
+    CHECK(strstr(buf, "fsm.update_us n=2 avg=20 ") != NULL);
+
+    // Truncated, still terminated
+    char small[16];
+    CHECK_INT(metrics_format(small, sizeof(small)), sizeof(small) - 1);
+    CHECK_INT(strlen(small), sizeof(small) - 1);
+    CHECK_INT(metrics_format(small, 0), 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_histogram_fields);
+    RUN_TEST(test_shared_histogram);
+    RUN_TEST(test_counters_and_gauges);
+    RUN_TEST(test_format);
+    TEST_EXIT();
+}
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "fakes.h"
+#include "test.h"
+
+#define WIDTH 72
+#define HEIGHT 40
+
+static SSD1306_t dev;
+
+static void start(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, WIDTH, HEIGHT);
+    ssd1306_clear_screen(&dev, false);
+    ssd1306_virtual_take_stats(&dev);
+    ssd1306_take_bus_stats(&dev);
+}
+
+static int lit_pixels(void)
+{
+    int lit = 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            lit += ssd1306_virtual_pixel(&dev, x, y);
+    return lit;
+}
+
+// Pixel model: what a drawing call should leave, compared with the internal
+// buffer and with the panel
+typedef uint8_t model_t[HEIGHT][WIDTH];
+
+// Logical pixel of the internal buffer, rows of a page reversed when flipped
+static int buffer_pixel(int x, int y)
+{
+    uint8_t byte = dev._page[y / 8]._segs[x];
+    return (byte >> (dev._flip ? 7 - y % 8 : y % 8)) & 1;
+}
+
+static void model_from_buffer(model_t model)
+{
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            model[y][x] = buffer_pixel(x, y);
+}
+
+static int buffer_mismatches(model_t model)
+{
+    int bad = 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            bad += buffer_pixel(x, y) != model[y][x];
+    return bad;
+}
+
+static int panel_mismatches(model_t model)
+{
+    int bad = 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            bad += ssd1306_virtual_pixel(&dev, x, y) != model[y][x];
+    return bad;
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// Random content in the buffer and on the panel
+static void random_frame(void)
+{
+    uint8_t frame[WIDTH * HEIGHT / 8];
+    for (int i = 0; i < sizeof(frame); i++)
+        frame[i] = rng();
+    ssd1306_set_buffer(&dev, frame);
+    ssd1306_show_buffer(&dev);
+}
+
+static void model_blit(model_t model, int xpos, int ypos, const uint8_t *bitmap, int width, int height,
+                       ssd1306_rop_t rop, bool invert)
+{
+    int stride = (width + 7) / 8;
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            int x = xpos + col, y = ypos + row;
+            if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+                continue;
+            int src = (bitmap[row * stride + col / 8] >> (7 - col % 8)) & 1;
+            if (invert)
+                src = !src;
+            if (rop == SSD1306_ROP_COPY)
+                model[y][x] = src;
+            else if (rop == SSD1306_ROP_OR)
+                model[y][x] |= src;
+            else if (rop == SSD1306_ROP_AND)
+                model[y][x] &= src;
+            else
+                model[y][x] ^= src;
+        }
+}
+
+// One blit into the buffer and the model, sent as dirty spans; false on the
+// first mismatch
+static bool blit_case(int xpos, int ypos, int width, int height, ssd1306_rop_t rop, bool invert, bool panel)
+{
+    uint8_t bitmap[24 * 3];
+    for (int i = 0; i < sizeof(bitmap); i++)
+        bitmap[i] = rng();
+
+    model_t model;
+    model_from_buffer(model);
+    model_blit(model, xpos, ypos, bitmap, width, height, rop, invert);
+    _ssd1306_blit(&dev, xpos, ypos, bitmap, width, height, rop, invert);
+    ssd1306_flush_dirty(&dev);
+
+    int bad = buffer_mismatches(model);
+    if (panel)
+        bad += panel_mismatches(model);
+    if (bad == 0)
+        return true;
+    fprintf(stderr, "blit %dx%d at (%d, %d) rop %d invert %d flip %d: %d pixels differ\n", width, height, xpos, ypos,
+            rop, invert, dev._flip, bad);
+    return false;
+}
+
+static const ssd1306_rop_t rops[] = {SSD1306_ROP_COPY, SSD1306_ROP_OR, SSD1306_ROP_AND, SSD1306_ROP_XOR};
+
+static void test_blit_edges_and_ops(void)
+{
+    static const int xs[] = {-24, -9, -1, 0, 3, WIDTH - 8, WIDTH - 1, WIDTH};
+    static const int ys[] = {-24, -8, -3, 0, 5, HEIGHT - 5, HEIGHT - 1, HEIGHT};
+
+    start();
+    rng_state = 1;
+    random_frame();
+    for (int r = 0; r < 4; r++)
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+                CHECK(blit_case(xs[i], ys[j], 13, 11, rops[r], (i + j) & 1, true));
+}
+
+static void test_blit_random(void)
+{
+    start();
+    rng_state = 2;
+    random_frame();
+    for (int i = 0; i < 500; i++)
+    {
+        int width = 1 + rng() % 24;
+        int height = 1 + rng() % 24;
+        int x = (int)(rng() % (WIDTH + 40)) - 30;
+        int y = (int)(rng() % (HEIGHT + 40)) - 30;
+        if (!blit_case(x, y, width, height, rops[rng() % 4], rng() & 1, true))
+        {
+            CHECK(false);
+            break;
+        }
+    }
+}
+
+// Flipped panels keep the rows of a page in reverse bit order; the panel is
+// addressed differently, so only the buffer is compared
+static void test_blit_flipped(void)
+{
+    start();
+    dev._flip = true;
+    rng_state = 3;
+    for (int i = 0; i < 300; i++)
+    {
+        int width = 1 + rng() % 24;
+        int height = 1 + rng() % 24;
+        int x = (int)(rng() % (WIDTH + 40)) - 30;
+        int y = (int)(rng() % (HEIGHT + 40)) - 30;
+        if (!blit_case(x, y, width, height, rops[rng() % 4], rng() & 1, false))
+        {
+            CHECK(false);
+            break;
+        }
+    }
+}
+
+// Expected frame after one ssd1306_wrap_arround
+static void model_wrap(model_t model, ssd1306_scroll_type_t scroll, int start, int end)
+{
+    model_t old;
+    memcpy(old, model, sizeof(old));
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            bool page_in = y / 8 >= start && y / 8 <= end;
+            bool seg_in = x >= start && x <= end;
+            if (scroll == SCROLL_RIGHT && page_in)
+                model[y][x] = old[y][(x + WIDTH - 1) % WIDTH];
+            else if (scroll == SCROLL_LEFT && page_in)
+                model[y][x] = old[y][(x + 1) % WIDTH];
+            else if (scroll == SCROLL_UP && seg_in)
+                model[y][x] = old[(y + 1) % HEIGHT][x];
+            else if (scroll == SCROLL_DOWN && seg_in)
+                model[y][x] = old[(y + HEIGHT - 1) % HEIGHT][x];
+            else if (scroll == PAGE_SCROLL_UP)
+                model[y][x] = old[(y + 8) % HEIGHT][x];
+            else if (scroll == PAGE_SCROLL_DOWN)
+                model[y][x] = old[(y + HEIGHT - 8) % HEIGHT][x];
+        }
+}
+
+static void test_wrap_every_scroll_type(void)
+{
+    // start/end are pages for left/right, columns for up/down
+    static const struct
+    {
+        ssd1306_scroll_type_t scroll;
+        int start, end;
+    } cases[] = {
+        {SCROLL_RIGHT, 1, 3}, {SCROLL_LEFT, 0, 4},       {SCROLL_UP, 5, 60},
+        {SCROLL_DOWN, 0, 99}, {PAGE_SCROLL_UP, 0, 0},     {PAGE_SCROLL_DOWN, 0, 0},
+    };
+    model_t model, original;
+
+    start();
+    rng_state = 4;
+    for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        random_frame();
+        model_from_buffer(model);
+        memcpy(original, model, sizeof(original));
+        // Twice: once shown as a whole frame, once page by page
+        for (int8_t delay = 0; delay <= 1; delay++)
+        {
+            model_wrap(model, cases[c].scroll, cases[c].start, cases[c].end > WIDTH - 1 ? WIDTH - 1 : cases[c].end);
+            ssd1306_wrap_arround(&dev, cases[c].scroll, cases[c].start, cases[c].end, delay);
+            CHECK_INT(buffer_mismatches(model), 0);
+            CHECK_INT(panel_mismatches(model), 0);
+        }
+        // A whole turn is back where it started
+        int turns = (cases[c].scroll == SCROLL_RIGHT || cases[c].scroll == SCROLL_LEFT) ? WIDTH
+                    : (cases[c].scroll == SCROLL_UP || cases[c].scroll == SCROLL_DOWN) ? HEIGHT
+                                                                                         : HEIGHT / 8;
+        for (int i = 2; i < turns; i++)
+            ssd1306_wrap_arround(&dev, cases[c].scroll, cases[c].start, cases[c].end, -1);
+        ssd1306_show_buffer(&dev);
+        CHECK_INT(buffer_mismatches(original), 0);
+        CHECK_INT(panel_mismatches(original), 0);
+    }
+}
+
+static void test_wrap_vertical_flipped(void)
+{
+    model_t model;
+
+    start();
+    dev._flip = true;
+    rng_state = 5;
+    for (int scroll = SCROLL_DOWN; scroll <= SCROLL_UP; scroll++)
+    {
+        uint8_t frame[WIDTH * HEIGHT / 8];
+        for (int i = 0; i < sizeof(frame); i++)
+            frame[i] = rng();
+        ssd1306_set_buffer(&dev, frame);
+        model_from_buffer(model);
+        model_wrap(model, scroll, 10, 20);
+        ssd1306_wrap_arround(&dev, scroll, 10, 20, -1);
+        CHECK_INT(buffer_mismatches(model), 0);
+    }
+}
+
+static void test_show_rect_burst(void)
+{
+    model_t model;
+
+    start();
+    ssd1306_set_burst(&dev, true);
+    rng_state = 6;
+    for (int page = 1; page <= 3; page++)
+        for (int seg = 10; seg <= 30; seg++)
+            dev._page[page]._segs[seg] = rng();
+    model_from_buffer(model);
+    ssd1306_take_bus_stats(&dev);
+    ssd1306_virtual_take_stats(&dev);
+
+    // One transaction for the whole rectangle
+    ssd1306_show_rect(&dev, 1, 10, 3, 21);
+    ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+    CHECK_INT(stats.transactions, 1);
+    CHECK_INT(stats.data, 3 * 21);
+    CHECK_INT(ssd1306_take_bus_stats(&dev).bytes, stats.bytes);
+    CHECK_INT(panel_mismatches(model), 0);
+
+    // Clipped to the panel
+    memset(&dev._page[HEIGHT / 8 - 1]._segs[WIDTH - 4], 0xFF, 4);
+    model_from_buffer(model);
+    ssd1306_show_rect(&dev, HEIGHT / 8 - 1, WIDTH - 4, 2, 8);
+    CHECK_INT(ssd1306_virtual_take_stats(&dev).data, 4);
+    CHECK_INT(panel_mismatches(model), 0);
+}
+
+// Buffer-only draws collect dirty spans; one flush sends them
+static void test_dirty_spans_batch(void)
+{
+    uint8_t square[8];
+    memset(square, 0xFF, sizeof(square));
+    model_t model;
+
+    for (int burst = 0; burst <= 1; burst++)
+    {
+        start();
+        ssd1306_set_burst(&dev, burst);
+        _ssd1306_bitmaps(&dev, 4, 8, square, 8, 8, false);
+        _ssd1306_bitmaps(&dev, 40, 8, square, 8, 8, false);
+        _ssd1306_bitmaps(&dev, 20, 24, square, 8, 8, false);
+        model_from_buffer(model);
+        CHECK_INT(ssd1306_virtual_take_stats(&dev).transactions, 0);
+
+        ssd1306_flush_dirty(&dev);
+        ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+        CHECK_INT(panel_mismatches(model), 0);
+        if (burst)
+        {
+            // Pages 1 to 3, columns 4 to 47, in one go
+            CHECK_INT(stats.transactions, 1);
+            CHECK_INT(stats.data, 3 * 44);
+        }
+        else
+        {
+            // One span per page: 4 to 47 on page 1, 20 to 27 on page 3
+            CHECK_INT(stats.transactions, 2);
+            CHECK_INT(stats.data, 44 + 8);
+        }
+
+        // Nothing left to send
+        ssd1306_flush_dirty(&dev);
+        CHECK_INT(ssd1306_virtual_take_stats(&dev).transactions, 0);
+    }
+}
+
+static void test_init_clears_the_panel(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, WIDTH, HEIGHT);
+    ssd1306_clear_screen(&dev, false);
+
+    CHECK_INT(lit_pixels(), 0);
+    // The first frame goes out whole, one page per transaction
+    ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+    CHECK(stats.data >= WIDTH * HEIGHT / 8);
+
+    ssd1306_clear_screen(&dev, true);
+    CHECK_INT(lit_pixels(), WIDTH * HEIGHT);
+}
+
+static void test_text_lands_on_the_glass(void)
+{
+    start();
+    ssd1306_display_text(&dev, 2, "HI", 2, false);
+
+    for (int c = 0; c < 2; c++)
+    {
+        const uint8_t *glyph = ssd1306_glyph("HI"[c], 0);
+        for (int x = 0; x < 8; x++)
+            for (int bit = 0; bit < 8; bit++)
+                CHECK_INT(ssd1306_virtual_pixel(&dev, c * 8 + x, 16 + bit), (glyph[x] >> bit) & 1);
+    }
+    // Nothing outside the text's cells
+    int lit = 0;
+    for (int c = 0; c < 2; c++)
+    {
+        const uint8_t *glyph = ssd1306_glyph("HI"[c], 0);
+        for (int x = 0; x < 8; x++)
+            lit += __builtin_popcount(glyph[x]);
+    }
+    CHECK_INT(lit_pixels(), lit);
+
+    // Only the two cells went over the bus, in one transaction
+    ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+    CHECK_INT(stats.data, 16);
+    ssd1306_bus_stats_t bus = ssd1306_take_bus_stats(&dev);
+    CHECK_INT(bus.transactions, stats.transactions);
+    CHECK_INT(bus.bytes, stats.bytes);
+    CHECK_INT(bus.wire_ns, SSD1306_I2C_WIRE_NS(stats.bytes));
+}
+
+static void test_inverted_text(void)
+{
+    start();
+    ssd1306_display_text(&dev, 0, "        E", 9, true); // a full line
+    const uint8_t *glyph = ssd1306_glyph('E', 0);
+    for (int x = 0; x < 8; x++)
+        for (int bit = 0; bit < 8; bit++)
+            CHECK_INT(ssd1306_virtual_pixel(&dev, 64 + x, bit), !((glyph[x] >> bit) & 1));
+    CHECK(ssd1306_virtual_pixel(&dev, 0, 0));
+    CHECK(!ssd1306_virtual_pixel(&dev, 0, 8));
+}
+
+static void test_bitmap_placement(void)
+{
+    // 16x16 filled square, rows of two bytes MSB first
+    uint8_t square[32];
+    memset(square, 0xFF, sizeof(square));
+
+    start();
+    ssd1306_bitmaps(&dev, 20, 12, square, 16, 16, false);
+    CHECK_INT(lit_pixels(), 16 * 16);
+    CHECK(ssd1306_virtual_pixel(&dev, 20, 12));
+    CHECK(ssd1306_virtual_pixel(&dev, 35, 27));
+    CHECK(!ssd1306_virtual_pixel(&dev, 19, 12));
+    CHECK(!ssd1306_virtual_pixel(&dev, 36, 27));
+    CHECK(!ssd1306_virtual_pixel(&dev, 20, 11));
+    CHECK(!ssd1306_virtual_pixel(&dev, 20, 28));
+}
+
+static void test_image_is_clipped_to_the_page(void)
+{
+    uint8_t image[16];
+    memset(image, 0xFF, sizeof(image));
+
+    // Half of it past the right edge, of the first and of the last page:
+    // nothing spills into the next page or past the frame
+    start();
+    ssd1306_display_image(&dev, 0, WIDTH - 8, image, sizeof(image));
+    ssd1306_display_image(&dev, HEIGHT / 8 - 1, WIDTH - 8, image, sizeof(image));
+    CHECK_INT(lit_pixels(), 2 * 8 * 8);
+    CHECK(ssd1306_virtual_pixel(&dev, WIDTH - 1, 0));
+    CHECK(ssd1306_virtual_pixel(&dev, WIDTH - 1, HEIGHT - 1));
+    CHECK(!ssd1306_virtual_pixel(&dev, 0, 8));
+    CHECK(!ssd1306_virtual_pixel(&dev, WIDTH - 9, HEIGHT - 1));
+
+    uint8_t frame[WIDTH * HEIGHT / 8];
+    ssd1306_get_buffer(&dev, frame);
+    int lit = 0;
+    for (int i = 0; i < sizeof(frame); i++)
+        lit += __builtin_popcount(frame[i]);
+    CHECK_INT(lit, 2 * 8 * 8);
+
+    // Outside the panel: ignored
+    ssd1306_display_image(&dev, HEIGHT / 8, 0, image, sizeof(image));
+    ssd1306_display_image(&dev, 0, WIDTH, image, sizeof(image));
+    ssd1306_display_image(&dev, 0, -8, image, sizeof(image));
+    CHECK_INT(lit_pixels(), 2 * 8 * 8);
+}
+
+static void test_text_box_scrolls_in_place(void)
+{
+    start();
+    // "AB" in a two character box, then scrolled left by one character
+    ssd1306_display_text_box1(&dev, 1, 8, "ABC", 2, 3, false, 0);
+
+    for (int c = 0; c < 2; c++)
+    {
+        const uint8_t *glyph = ssd1306_glyph("BC"[c], 0);
+        for (int x = 0; x < 8; x++)
+            for (int bit = 0; bit < 8; bit++)
+                CHECK_INT(ssd1306_virtual_pixel(&dev, 8 + c * 8 + x, 8 + bit), (glyph[x] >> bit) & 1);
+    }
+    // The box once, then once per scrolled column, nothing else
+    ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+    CHECK_INT(stats.data, 16 * (1 + 8));
+    CHECK(!ssd1306_virtual_pixel(&dev, 7, 8) && !ssd1306_virtual_pixel(&dev, 24, 8));
+}
+
+static void test_unchanged_frame_costs_nothing(void)
+{
+    uint8_t frame[WIDTH * HEIGHT / 8];
+
+    start();
+    ssd1306_get_buffer(&dev, frame);
+    frame[3 * WIDTH + 40] = 0x3C;
+    ssd1306_set_buffer(&dev, frame);
+    ssd1306_show_buffer(&dev);
+
+    // One changed column: one short run on one page
+    ssd1306_virtual_stats_t stats = ssd1306_virtual_take_stats(&dev);
+    ssd1306_take_bus_stats(&dev);
+    CHECK_INT(stats.data, 1);
+    CHECK(stats.transactions <= 2);
+    CHECK(ssd1306_virtual_pixel(&dev, 40, 26));
+    CHECK(!ssd1306_virtual_pixel(&dev, 40, 25));
+
+    ssd1306_show_buffer(&dev);
+    stats = ssd1306_virtual_take_stats(&dev);
+    CHECK_INT(stats.transactions, 0);
+    CHECK_INT(ssd1306_take_bus_stats(&dev).bytes, 0);
+}
+
+static void test_pbm_dump(void)
+{
+    char path[] = "/tmp/ssd1306_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    start();
+    ssd1306_display_text(&dev, 0, "A", 1, false);
+    CHECK(ssd1306_virtual_dump_pbm(&dev, path));
+
+    FILE *fp = fopen(path, "rb");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+        return;
+    int w = 0, h = 0;
+    CHECK_INT(fscanf(fp, "P4 %d %d", &w, &h), 2);
+    fgetc(fp);
+    CHECK_INT(w, WIDTH);
+    CHECK_INT(h, HEIGHT);
+
+    uint8_t row[WIDTH / 8];
+    const uint8_t *glyph = ssd1306_glyph('A', 0);
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        CHECK_INT(fread(row, 1, sizeof(row), fp), sizeof(row));
+        for (int x = 0; x < WIDTH; x++)
+        {
+            int expected = (x < 8 && y < 8) ? (glyph[x] >> y) & 1 : 0;
+            CHECK_INT((row[x / 8] >> (7 - x % 8)) & 1, expected);
+        }
+    }
+    fclose(fp);
+    remove(path);
+}
+
+int main(void)
+{
+    RUN_TEST(test_init_clears_the_panel);
+    RUN_TEST(test_text_lands_on_the_glass);
+    RUN_TEST(test_inverted_text);
+    RUN_TEST(test_bitmap_placement);
+    RUN_TEST(test_image_is_clipped_to_the_page);
+    RUN_TEST(test_text_box_scrolls_in_place);
+    RUN_TEST(test_unchanged_frame_costs_nothing);
+    RUN_TEST(test_pbm_dump);
+    RUN_TEST(test_blit_edges_and_ops);
+    RUN_TEST(test_blit_random);
+    RUN_TEST(test_blit_flipped);
+    RUN_TEST(test_wrap_every_scroll_type);
+    RUN_TEST(test_wrap_vertical_flipped);
+    RUN_TEST(test_show_rect_burst);
+    RUN_TEST(test_dirty_spans_batch);
+    TEST_EXIT();
+}
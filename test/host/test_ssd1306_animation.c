@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "fakes.h"
+#include "test.h"
+
+#define WIDTH 72
+#define HEIGHT 40
+#define FRAMES 6 // curtain and wipe boundaries off the page edges
+#define FPS 10
+
+static SSD1306_t dev;
+static ssd1306_anim_t anim;
+static uint8_t from[WIDTH * HEIGHT / 8];
+static uint8_t to[WIDTH * HEIGHT / 8];
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// Panel showing from, to a random target
+static void start(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, WIDTH, HEIGHT);
+    for (int i = 0; i < sizeof(from); i++)
+    {
+        from[i] = rng();
+        to[i] = rng();
+    }
+    ssd1306_set_buffer(&dev, from);
+    ssd1306_show_buffer(&dev);
+}
+
+static int frame_pixel(const uint8_t *frame, int x, int y)
+{
+    return (frame[y / 8 * WIDTH + x] >> (y % 8)) & 1;
+}
+
+// Pixel of frame k of an animation, as the effect is specified
+static int expected_pixel(ssd1306_anim_type_t type, int k, int x, int y)
+{
+    static const uint8_t bayer4[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    int col, row;
+
+    switch (type)
+    {
+    case SSD1306_ANIM_FADEOUT:
+    {
+        // Rows above the curtain are dark, the rest of its page lit
+        int rows = HEIGHT * k / FRAMES;
+        if (y < rows)
+            return 0;
+        if (y / 8 * 8 < rows)
+            return 1;
+        return frame_pixel(from, x, y);
+    }
+    case SSD1306_ANIM_DISSOLVE:
+        return bayer4[y & 3][x & 3] < 16 * k / FRAMES ? frame_pixel(to, x, y) : frame_pixel(from, x, y);
+    case SSD1306_ANIM_WIPE_RIGHT:
+        return x < WIDTH * k / FRAMES ? frame_pixel(to, x, y) : frame_pixel(from, x, y);
+    case SSD1306_ANIM_WIPE_LEFT:
+        return x >= WIDTH - WIDTH * k / FRAMES ? frame_pixel(to, x, y) : frame_pixel(from, x, y);
+    case SSD1306_ANIM_WIPE_DOWN:
+        return y < HEIGHT * k / FRAMES ? frame_pixel(to, x, y) : frame_pixel(from, x, y);
+    case SSD1306_ANIM_SLIDE_LEFT:
+        // from leaves to the left, to follows it in
+        col = x + WIDTH * k / FRAMES;
+        return col < WIDTH ? frame_pixel(from, col, y) : frame_pixel(to, col - WIDTH, y);
+    case SSD1306_ANIM_SLIDE_RIGHT:
+        col = x - WIDTH * k / FRAMES;
+        return col >= 0 ? frame_pixel(from, col, y) : frame_pixel(to, col + WIDTH, y);
+    case SSD1306_ANIM_SLIDE_UP:
+        row = y + HEIGHT * k / FRAMES;
+        return row < HEIGHT ? frame_pixel(from, x, row) : frame_pixel(to, x, row - HEIGHT);
+    case SSD1306_ANIM_SLIDE_DOWN:
+        row = y - HEIGHT * k / FRAMES;
+        return row >= 0 ? frame_pixel(from, x, row) : frame_pixel(to, x, row + HEIGHT);
+    default:
+        return -1;
+    }
+}
+
+static int mismatches(ssd1306_anim_type_t type, int k)
+{
+    int bad = 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            bad += ssd1306_virtual_pixel(&dev, x, y) != expected_pixel(type, k, x, y);
+    return bad;
+}
+
+// Every frame of every buffer effect, stepped as the UI loop does
+static void test_effects_frame_by_frame(void)
+{
+    static const ssd1306_anim_type_t types[] = {
+        SSD1306_ANIM_FADEOUT,    SSD1306_ANIM_DISSOLVE,    SSD1306_ANIM_WIPE_LEFT,
+        SSD1306_ANIM_WIPE_RIGHT, SSD1306_ANIM_WIPE_DOWN,   SSD1306_ANIM_SLIDE_LEFT,
+        SSD1306_ANIM_SLIDE_RIGHT, SSD1306_ANIM_SLIDE_UP,   SSD1306_ANIM_SLIDE_DOWN,
+    };
+
+    for (int t = 0; t < sizeof(types) / sizeof(types[0]); t++)
+    {
+        start();
+        ssd1306_anim_begin(&dev, &anim, types[t], types[t] == SSD1306_ANIM_FADEOUT ? NULL : to, FRAMES, FPS);
+        for (int k = 1; k <= FRAMES; k++)
+        {
+            bool running = ssd1306_anim_step(&dev, &anim);
+            CHECK_INT(running, k < FRAMES);
+            int bad = mismatches(types[t], k);
+            if (bad != 0)
+                fprintf(stderr, "effect %d frame %d: %d pixels differ\n", types[t], k, bad);
+            CHECK_INT(bad, 0);
+
+            // A tick short of the period: nothing is drawn
+            fake_clock_advance_us(1000000 / FPS - 1000000 / CONFIG_FREERTOS_HZ);
+            CHECK(ssd1306_anim_step(&dev, &anim) == running);
+            CHECK_INT(anim._frame, k);
+            fake_clock_advance_us(1000000 / CONFIG_FREERTOS_HZ);
+        }
+    }
+}
+
+static void test_run_blocks_until_the_target(void)
+{
+    start();
+    ssd1306_anim_begin(&dev, &anim, SSD1306_ANIM_SLIDE_UP, to, FRAMES, FPS);
+    int64_t begin = fake_clock_now_us();
+    ssd1306_anim_run(&dev, &anim);
+    CHECK(!anim._running);
+    CHECK_INT(mismatches(SSD1306_ANIM_SLIDE_UP, FRAMES), 0);
+    CHECK_INT(fake_clock_now_us() - begin, (FRAMES - 1) * 1000000LL / FPS);
+
+    // Stopped: no more frames
+    ssd1306_anim_begin(&dev, &anim, SSD1306_ANIM_WIPE_DOWN, NULL, FRAMES, FPS);
+    ssd1306_anim_stop(&anim);
+    CHECK(!ssd1306_anim_step(&dev, &anim));
+    CHECK_INT(anim._frame, 0);
+}
+
+static void test_fadeout_ends_dark(void)
+{
+    start();
+    ssd1306_fadeout(&dev);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            CHECK(!ssd1306_virtual_pixel(&dev, x, y));
+}
+
+static void test_contrast_ramp(void)
+{
+    start();
+    ssd1306_anim_contrast(&dev, &anim, 0, 200, 4, FPS);
+    for (int k = 1; k <= 4; k++)
+    {
+        ssd1306_anim_step(&dev, &anim);
+        CHECK_INT(ssd1306_virtual_contrast(&dev), 200 * k / 4);
+        fake_clock_advance_us(1000000 / FPS);
+    }
+    CHECK(!ssd1306_anim_step(&dev, &anim));
+}
+
+// One ssd1306_wrap_arround per frame: after FRAMES frames, pages 1 to 2 are
+// FRAMES columns further left, the others unchanged
+static void test_wrap_animation(void)
+{
+    start();
+    ssd1306_anim_wrap(&dev, &anim, SCROLL_LEFT, 1, 2, FRAMES, FPS);
+    ssd1306_anim_run(&dev, &anim);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            int src = (y >= 8 && y < 24) ? (x + FRAMES) % WIDTH : x;
+            CHECK_INT(ssd1306_virtual_pixel(&dev, x, y), frame_pixel(from, src, y));
+        }
+}
+
+int main(void)
+{
+    RUN_TEST(test_effects_frame_by_frame);
+    RUN_TEST(test_run_blocks_until_the_target);
+    RUN_TEST(test_fadeout_ends_dark);
+    RUN_TEST(test_contrast_ramp);
+    RUN_TEST(test_wrap_animation);
+    TEST_EXIT();
+}
@@ -0,0 +1,170 @@
+#include "time_sync_wifi.h"
+#include "fakes.h"
+#include "test.h"
+
+#define SERVER_EPOCH_S 1760000000LL // 2025-10-09
+#define SECONDS(x) ((x) * 1000000LL)
+
+static void boot(esp_reset_reason_t reason)
+{
+    fake_reboot(reason);
+    time_sync_init();
+}
+
+static void sync_now(int64_t epoch_s)
+{
+    fake_sntp_set_server_time(SECONDS(epoch_s));
+    fake_wifi_got_ip();
+}
+
+static void test_first_boot_has_no_time(void)
+{
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    CHECK_INT(time_get_source(), TIME_SOURCE_NONE);
+    CHECK(!time_is_valid());
+    CHECK(!fake_wall_clock_set(NULL));
+    CHECK_INT(time_get_last_sync_epoch(), -1);
+    CHECK_INT(time_get_error_bound_ms(), -1);
+    CHECK_INT(time_get_sync_age_s(), -1);
+}
+
+static void test_sntp_sync_saves_anchor(void)
+{
+    struct timeval tv;
+
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    fake_clock_advance_us(SECONDS(5));
+    sync_now(SERVER_EPOCH_S);
+
+    CHECK_INT(time_get_source(), TIME_SOURCE_SNTP);
+    CHECK(time_is_valid());
+    CHECK(fake_wall_clock_set(&tv));
+    CHECK_INT(tv.tv_sec, SERVER_EPOCH_S);
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S);
+    CHECK_INT(time_get_resets_since_sync(), 0);
+    CHECK_INT(time_get_error_bound_ms(), 500);
+    CHECK_INT(fake_nvs_commits(), 1);
+
+    // The bound grows with the age of the sync: 5000 ppm of 10 min is 3 s
+    fake_clock_advance_us(SECONDS(600));
+    CHECK_INT(time_get_sync_age_s(), 600);
+    CHECK_INT(time_get_error_bound_ms(), 500 + 3000);
+}
+
+static void test_warm_boot_restores_from_rtc(void)
+{
+    struct timeval tv;
+
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    sync_now(SERVER_EPOCH_S);
+    int commits = fake_nvs_commits();
+
+    // Ten minutes later the watchdog resets the chip; the RTC timer keeps counting
+    fake_clock_advance_us(SECONDS(600));
+    boot(ESP_RST_TASK_WDT);
+
+    CHECK_INT(time_get_source(), TIME_SOURCE_RTC);
+    CHECK(time_is_valid());
+    CHECK(fake_wall_clock_set(&tv));
+    CHECK_INT(tv.tv_sec, SERVER_EPOCH_S + 600);
+    CHECK_INT(time_get_resets_since_sync(), 1);
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S);
+    CHECK_INT(time_get_error_bound_ms(), 500 + 3000);
+    CHECK_INT(fake_nvs_commits(), commits); // the restore doesn't write flash
+
+    // A second soft reset keeps counting
+    fake_clock_advance_us(SECONDS(60));
+    boot(ESP_RST_SW);
+    CHECK_INT(time_get_source(), TIME_SOURCE_RTC);
+    CHECK_INT(time_get_resets_since_sync(), 2);
+    CHECK(fake_wall_clock_set(&tv));
+    CHECK_INT(tv.tv_sec, SERVER_EPOCH_S + 660);
+}
+
+static void test_stale_rtc_restore_is_not_valid(void)
+{
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    sync_now(SERVER_EPOCH_S);
+
+    // 5000 ppm reaches the 5 min limit after a bit under 17 hours
+    fake_clock_advance_us(SECONDS(17 * 3600));
+    boot(ESP_RST_PANIC);
+    CHECK_INT(time_get_source(), TIME_SOURCE_RTC);
+    CHECK(!time_is_valid());
+}
+
+static void test_cold_boot_restores_last_known(void)
+{
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    sync_now(SERVER_EPOCH_S);
+
+    fake_clock_advance_us(SECONDS(3600));
+    boot(ESP_RST_POWERON);
+
+    CHECK_INT(time_get_source(), TIME_SOURCE_LAST_KNOWN);
+    CHECK(!time_is_valid());
+    CHECK(!fake_wall_clock_set(NULL)); // elapsed time is unknown, the clock stays unset
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S);
+    CHECK_INT(time_get_resets_since_sync(), 1);
+    CHECK_INT(time_get_error_bound_ms(), -1);
+
+    // A brownout loses the RTC domain as well
+    boot(ESP_RST_BROWNOUT);
+    CHECK_INT(time_get_source(), TIME_SOURCE_LAST_KNOWN);
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S);
+}
+
+static void test_cold_boot_without_nvs_has_no_time(void)
+{
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    sync_now(SERVER_EPOCH_S);
+
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    CHECK_INT(time_get_source(), TIME_SOURCE_NONE);
+    CHECK_INT(time_get_last_sync_epoch(), -1);
+    CHECK_INT(time_get_resets_since_sync(), 0);
+}
+
+static void test_failed_resync_keeps_source(void)
+{
+    fake_nvs_erase_all();
+    boot(ESP_RST_POWERON);
+    sync_now(SERVER_EPOCH_S);
+
+    fake_clock_advance_us(SECONDS(600));
+    boot(ESP_RST_SW);
+    CHECK_INT(time_get_source(), TIME_SOURCE_RTC);
+
+    // Server unreachable: ten polls two seconds apart, then give up
+    int64_t before = fake_clock_now_us();
+    fake_sntp_set_server_time(-1);
+    fake_wifi_got_ip();
+    CHECK_INT(fake_clock_now_us() - before, SECONDS(18));
+    CHECK_INT(time_get_source(), TIME_SOURCE_RTC);
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S);
+
+    // Reachable again: back to SNTP with a fresh anchor
+    sync_now(SERVER_EPOCH_S + 700);
+    CHECK_INT(time_get_source(), TIME_SOURCE_SNTP);
+    CHECK_INT(time_get_last_sync_epoch(), SERVER_EPOCH_S + 700);
+    CHECK_INT(time_get_resets_since_sync(), 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_first_boot_has_no_time);
+    RUN_TEST(test_sntp_sync_saves_anchor);
+    RUN_TEST(test_warm_boot_restores_from_rtc);
+    RUN_TEST(test_stale_rtc_restore_is_not_valid);
+    RUN_TEST(test_cold_boot_restores_last_known);
+    RUN_TEST(test_cold_boot_without_nvs_has_no_time);
+    RUN_TEST(test_failed_resync_keeps_source);
+    TEST_EXIT();
+}
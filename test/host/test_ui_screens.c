@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "u8g2.h"
+#include "u8g2_ssd1306_hal.h"
+#include "ui_screens.h"
+#include "fsm.h"
+#include "ssd1306.h"
+#include "fakes.h"
+#include "budget.h"
+#include "test.h"
+
+// The UI's screens drawn by u8g2 and sent through the same byte callback as
+// on the device, into the virtual panel. Bus budgets are checked for every
+// refresh; the golden tests compare whole screens with the PBMs in
+// test/host/golden.
+//
+// A different golden fails the test and leaves the rendered image next to
+// the test binary. A missing one is reported and skipped: the goldens are
+// made from a real u8g2 build. After checking the image (any PBM viewer),
+// build the update_goldens target (UPDATE_GOLDEN=1) to write them to
+// test/host/golden and commit them.
+
+#define FRAME_SIZE (DISPLAY_WIDTH * DISPLAY_HEIGHT / 8)
+
+static SSD1306_t dev;
+static u8g2_t u8g2;
+static uint8_t shown[FRAME_SIZE]; // the flush task's copy of the panel
+static bool shown_valid;
+
+typedef void (*render_fn)(const void *ctx);
+
+static void render_status(const void *ctx)
+{
+    ui_render_status(&u8g2, ctx);
+}
+
+static void render_log(const void *ctx)
+{
+    ui_render_log(&u8g2, ctx);
+}
+
+static void render_loading(const void *ctx)
+{
+    ui_render_loading(&u8g2);
+}
+
+// Full-buffer mode unless page_buffer, as set up by app_main
+static void start(bool page_buffer)
+{
+    memset(&dev, 0, sizeof(dev));
+    i2c_master_init(&dev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
+    ssd1306_init(&dev, DISPLAY_WIDTH, DISPLAY_HEIGHT); // panel geometry for the pixel readout
+    u8g2_ssd1306_hal_init(&dev);
+    if (page_buffer)
+        u8g2_Setup_ssd1306_i2c_72x40_er_1(&u8g2, U8G2_R0, u8g2_ssd1306_i2c_byte_cb, u8g2_ssd1306_gpio_and_delay_cb);
+    else
+        u8g2_Setup_ssd1306_i2c_72x40_er_f(&u8g2, U8G2_R0, u8g2_ssd1306_i2c_byte_cb, u8g2_ssd1306_gpio_and_delay_cb);
+    u8g2_InitDisplay(&u8g2);
+    u8g2_SetPowerSave(&u8g2, 0);
+    shown_valid = false;
+    reset_stats(&dev);
+}
+
+// ui_present and the flush task of the full-buffer mode
+static void present(render_fn render, const void *ctx)
+{
+    u8g2_ClearBuffer(&u8g2);
+    render(ctx);
+    ui_send_changed_tiles(&u8g2, u8g2_GetBufferPtr(&u8g2), shown, shown_valid);
+    shown_valid = true;
+}
+
+// ui_present of the page-buffer modes
+static void present_pages(render_fn render, const void *ctx)
+{
+    u8g2_FirstPage(&u8g2);
+    do
+    {
+        render(ctx);
+    } while (u8g2_NextPage(&u8g2));
+}
+
+// draw_current_state without the unchanged-frame skip
+static void present_status(void (*present_fn)(render_fn, const void *), float temp, float hum)
+{
+    char fan_line[20], timer_line[20], state_line[20];
+    char temp_line[32], hum_line[32];
+    fsm_get_display_lines(fan_line, timer_line, state_line);
+    snprintf(temp_line, sizeof(temp_line), "%.1f", temp);
+    snprintf(hum_line, sizeof(hum_line), "%.1f", hum);
+
+    status_screen_t screen = {
+        .hum_line = hum_line,
+        .temp_line = temp_line,
+        .timer_line = timer_line,
+        .state_icon = fsm_get_state_icon(),
+        .fan_on = fsm_is_fan_on(),
+    };
+    present_fn(render_status, &screen);
+}
+
+// A log of a few FSM cycles, written by the FSM itself
+static void fill_log(int cycles)
+{
+    fake_clock_advance_us(30 * 1000000LL); // past the boot quiet period
+    for (int i = 0; i < cycles; i++)
+    {
+        fsm_update(80.0f); // COOLING
+        fake_clock_advance_us(60 * 1000000LL);
+        fsm_update(50.0f); // WAITING
+        fake_clock_advance_us(121 * 60 * 1000000LL);
+        fsm_update(50.0f); // IDLE
+    }
+}
+
+static const bus_budget_t budget_status = {"status page refresh", UI_FRAME_BUDGET_BYTES};
+static const bus_budget_t budget_log = {"log page refresh", UI_FRAME_BUDGET_BYTES};
+static const bus_budget_t budget_loading = {"loading screen", UI_FRAME_BUDGET_BYTES};
+
+static bool read_file(const char *path, uint8_t *buf, size_t size, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+    *len = fread(buf, 1, size, fp);
+    fclose(fp);
+    return true;
+}
+
+// The panel against test/host/golden/<name>.pbm
+static void check_golden(const char *name)
+{
+    char golden[512], actual[512];
+    snprintf(golden, sizeof(golden), "%s/%s.pbm", GOLDEN_DIR, name);
+    snprintf(actual, sizeof(actual), "%s/%s.pbm", OUTPUT_DIR, name);
+
+    if (getenv("UPDATE_GOLDEN") != NULL)
+    {
+        mkdir(GOLDEN_DIR, 0755);
+        CHECK(ssd1306_virtual_dump_pbm(&dev, golden));
+        printf("%s: golden written\n", golden);
+        return;
+    }
+
+    CHECK(ssd1306_virtual_dump_pbm(&dev, actual));
+    uint8_t want[1024], got[1024];
+    size_t want_len = 0, got_len = 0;
+    CHECK(read_file(actual, got, sizeof(got), &got_len));
+    if (!read_file(golden, want, sizeof(want), &want_len))
+    {
+        printf("SKIP %s: no golden, rendered %s\n", golden, actual);
+        return;
+    }
+    if (want_len != got_len || memcmp(want, got, got_len) != 0)
+    {
+        int pixels = 0;
+        for (size_t i = 0; i < got_len && i < want_len; i++)
+            pixels += __builtin_popcount(want[i] ^ got[i]);
+        fprintf(stderr, "%s: %d pixels differ, rendered %s\n", golden, pixels, actual);
+        test_failures++;
+    }
+}
+
+// Transactions and bytes of the frame just sent, checked against the budget
+static void report_screen(const char *name, const bus_budget_t *budget)
+{
+    ssd1306_bus_stats_t bus = ssd1306_take_bus_stats(&dev);
+    ssd1306_virtual_stats_t panel = ssd1306_virtual_take_stats(&dev);
+    printf("{\"screen\":\"%s\",\"transactions\":%lu,\"bytes\":%lu,\"data\":%lu,\"commands\":%lu}\n", name,
+           (unsigned long)bus.transactions, (unsigned long)bus.bytes, (unsigned long)panel.data,
+           (unsigned long)panel.commands);
+    CHECK(bus.bytes <= budget->max_bytes);
+}
+
+static void test_golden_status(void)
+{
+    fake_nvs_erase_all();
+    fsm_init();
+    fake_clock_advance_us(90 * 1000000LL);
+
+    start(false);
+    present_status(present, 23.4f, 55.0f);
+    report_screen("status_idle", &budget_status);
+    check_golden("status_idle");
+
+    start(false);
+    fsm_update(80.0f);
+    fake_clock_advance_us(5 * 60 * 1000000LL);
+    present_status(present, 24.1f, 80.0f);
+    report_screen("status_cooling", &budget_status);
+    check_golden("status_cooling");
+}
+
+static void test_golden_log(void)
+{
+    log_screen_t screen;
+
+    fake_nvs_erase_all();
+    fsm_init();
+    fill_log(3);
+
+    start(false);
+    ui_load_log_screen(&screen, 0);
+    present(render_log, &screen);
+    report_screen("log_page1", &budget_log);
+    check_golden("log_page1");
+
+    start(false);
+    ui_load_log_screen(&screen, 1);
+    present(render_log, &screen);
+    report_screen("log_page2", &budget_log);
+    check_golden("log_page2");
+}
+
+static void test_golden_loading(void)
+{
+    start(false);
+    present(render_loading, NULL);
+    report_screen("loading", &budget_loading);
+    check_golden("loading");
+}
+
+static void test_status_refresh(void)
+{
+    fake_nvs_erase_all();
+    fsm_init();
+    start(false);
+
+    // First frame: every tile
+    present_status(present, 23.4f, 55.0f);
+    check_budget(&dev, &budget_status);
+
+    // A second later only the timer changed
+    fake_clock_advance_us(1000000);
+    present_status(present, 23.4f, 55.0f);
+    ssd1306_bus_stats_t tick = ssd1306_take_bus_stats(&dev);
+    ssd1306_virtual_take_stats(&dev);
+    CHECK(tick.transactions > 0);
+    CHECK(tick.bytes < UI_FRAME_BUDGET_BYTES / 2);
+
+    // State change: icon, bullet, readings and timer
+    fsm_update(80.0f);
+    present_status(present, 24.1f, 80.0f);
+    check_budget(&dev, &budget_status);
+}
+
+static void test_status_refresh_page_buffer(void)
+{
+    fake_nvs_erase_all();
+    fsm_init();
+    start(true);
+
+    // Every row is sent every frame
+    present_status(present_pages, 23.4f, 55.0f);
+    check_budget(&dev, &budget_status);
+    fake_clock_advance_us(1000000);
+    present_status(present_pages, 23.4f, 55.0f);
+    check_budget(&dev, &budget_status);
+}
+
+static void test_log_refresh(void)
+{
+    log_screen_t screen;
+
+    fake_nvs_erase_all();
+    fsm_init();
+    fill_log(3);
+    start(false);
+
+    int pages = ui_load_log_screen(&screen, 0);
+    CHECK(pages >= 2);
+    CHECK_INT(screen.shown, MAX_LOG_LINES);
+    present(render_log, &screen);
+    check_budget(&dev, &budget_log);
+
+    // Next page: every text row changes
+    ui_load_log_screen(&screen, 1);
+    present(render_log, &screen);
+    check_budget(&dev, &budget_log);
+}
+
+static void test_log_refresh_page_buffer(void)
+{
+    log_screen_t screen;
+
+    fake_nvs_erase_all();
+    fsm_init();
+    fill_log(3);
+    start(true);
+
+    ui_load_log_screen(&screen, 0);
+    present_pages(render_log, &screen);
+    check_budget(&dev, &budget_log);
+}
+
+static void test_log_without_nvs(void)
+{
+    log_screen_t screen;
+
+    fake_nvs_erase_all();
+    start(false);
+    CHECK_INT(ui_load_log_screen(&screen, 0), -1);
+    CHECK(screen.error);
+    present(render_log, &screen);
+    check_budget(&dev, &budget_log);
+}
+
+static void test_loading(void)
+{
+    start(false);
+    present(render_loading, NULL);
+    check_budget(&dev, &budget_loading);
+
+    // One line of text at the top, baseline on row 8
+    int top = 0, below = 0;
+    for (int y = 0; y < DISPLAY_HEIGHT; y++)
+        for (int x = 0; x < DISPLAY_WIDTH; x++)
+        {
+            if (y <= 8)
+                top += ssd1306_virtual_pixel(&dev, x, y);
+            else if (y >= 12)
+                below += ssd1306_virtual_pixel(&dev, x, y);
+        }
+    CHECK(top > 0);
+    CHECK_INT(below, 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_status_refresh);
+    RUN_TEST(test_status_refresh_page_buffer);
+    RUN_TEST(test_log_refresh);
+    RUN_TEST(test_log_refresh_page_buffer);
+    RUN_TEST(test_log_without_nvs);
+    RUN_TEST(test_loading);
+    RUN_TEST(test_golden_status);
+    RUN_TEST(test_golden_log);
+    RUN_TEST(test_golden_loading);
+    TEST_EXIT();
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Convert an event trace dump from the serial log to Chrome trace JSON.
+
+The firmware prints its event ring (main/event_trace.c, trace_dump()) as
+TRACE lines, anything else in the log is ignored. Every dump in the log
+becomes its own process in the output, each event track one thread.
+Open the result in https://ui.perfetto.dev or chrome://tracing.
+
+usage: trace_to_chrome.py monitor.log trace.json
+"""
+
+import json
+import sys
+
+
+def unwrap(times):
+    # The firmware keeps the low 32 bits of the microsecond timer
+    out = []
+    offset = 0
+    last = None
+    for t in times:
+        if last is not None and t + offset < last - (1 << 31):
+            offset += 1 << 32
+        last = t + offset
+        out.append(last)
+    return out
+
+
+def read_dumps(path):
+    dumps = []
+    dump = None
+    with open(path, errors='replace') as f:
+        for line in f:
+            # Tolerate log prefixes and colour codes in front of the marker
+            at = line.find('TRACE ')
+            if at < 0:
+                continue
+            fields = line[at:].split()
+            kind = fields[1] if len(fields) > 1 else ''
+            if kind == 'BEGIN':
+                dump = {'names': {}, 'events': []}
+            elif dump is None:
+                continue
+            elif kind == 'N' and len(fields) == 5:
+                dump['names'][int(fields[2])] = (fields[3], fields[4])
+            elif kind == 'E' and len(fields) == 6:
+                dump['events'].append((int(fields[2]), int(fields[3]), fields[4], int(fields[5])))
+            elif kind == 'END':
+                dumps.append(dump)
+                dump = None
+    return dumps
+
+
+def convert(dumps):
+    out = []
+    for pid, dump in enumerate(dumps, 1):
+        tracks = {}
+        depth = {}
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': pid, 'args': {'name': 'dump %d' % pid}})
+        times = unwrap([e[0] for e in dump['events']])
+        for (_, event_id, phase, arg), ts in zip(dump['events'], times):
+            name, track = dump['names'].get(event_id, ('event %d' % event_id, 'unknown'))
+            # The ring may start in the middle of a span
+            if phase == 'E' and depth.get(name, 0) == 0:
+                continue
+            if phase in 'BE':
+                depth[name] = depth.get(name, 0) + (1 if phase == 'B' else -1)
+            if track not in tracks:
+                tracks[track] = len(tracks) + 1
+                out.append({'ph': 'M', 'name': 'thread_name', 'pid': pid, 'tid': tracks[track], 'args': {'name': track}})
+            event = {'name': name, 'ph': phase, 'ts': ts, 'pid': pid, 'tid': tracks[track]}
+            if phase == 'i':
+                event['s'] = 't'
+                event['args'] = {'arg': arg}
+            out.append(event)
+    return out
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    dumps = read_dumps(sys.argv[1])
+    if not dumps:
+        sys.exit('%s: no complete TRACE BEGIN/END dump found' % sys.argv[1])
+    with open(sys.argv[2], 'w') as f:
+        json.dump({'traceEvents': convert(dumps), 'displayTimeUnit': 'ms'}, f)
+
+
+if __name__ == '__main__':
+    main()